@@ -25,61 +25,81 @@
  */
 
 #include "max6675.h"
+#include "oven_filter.h"
+#include "oven_cal.h"
+#include "oven_stats.h"
 #include "ovencon.h"
 
 #include <avr/pgmspace.h>
+#include <avr/interrupt.h>
 #include <avr/io.h>
 
-#ifdef TEMP_AVERAGING
-int16_t temps[DEVICES][AVERAGE];
-#endif
+// chip-select table (see TC_TABLE in ovencon.h)
+typedef struct
+{
+    volatile uint8_t   *port;   // PORTx; DDRx is the register below it
+    uint8_t             pin;
+    uint8_t             type;
+} s_tc_device;
+
+static const s_tc_device tc_devices[DEVICES] = TC_TABLE;
+
+// worst case conversion times, in stats_now() ticks (clk/64); reading a chip
+// mid-conversion aborts it, so nothing is read more often than this
+#define TICKS_PER_MS    (F_CPU/64000)
+static const uint16_t tc_conversion[] = {
+    220 * TICKS_PER_MS,     // TC_MAX6675
+    100 * TICKS_PER_MS,     // TC_MAX31855
+};
+
+// spike rejection and averaging per device
+s_filter temps[DEVICES];
 
-// defined below
-int16_t thermocouple_lookup(int16_t x);
+static int16_t  tc_value[DEVICES];      // filtered reading, or fault code
+static int16_t  tc_fine[DEVICES];       // oversampled reading, 1/16C
+static int16_t  tc_cj[DEVICES];         // cold junction, 1/16C
+static uint8_t  tc_faults[DEVICES];
+static uint16_t tc_last[DEVICES];       // stats_now() at the last read
+static uint8_t  tc_next;
 
 static void _max6675_select(uint8_t device, uint8_t cs)
 {
-    switch(device)
-    {
-        // PB0
-        case 0:
-        	DDRB |= _BV(0);
-
-            if(cs)  PORTB &= ~(_BV(0)); // active-low
-            else    PORTB |= _BV(0);
-
-            break;
-        // PC6
-        case 1:
-#ifndef BOTTOM_THERM
-            DDRC |= _BV(6);
-        	if(cs)  PORTC &= ~(_BV(6)); // active-low
-            else    PORTC |= _BV(6);
-#endif
-            break;
-    }
+    const s_tc_device *dev = &tc_devices[device];
 
+    *(dev->port - 1) |= _BV(dev->pin);
+
+    if(cs)  *dev->port &= ~(_BV(dev->pin)); // active-low
+    else    *dev->port |= _BV(dev->pin);
+}
+
+static uint8_t _spi_byte(void)
+{
+    SPDR = 0xFF;
+    loop_until_bit_is_set(SPSR,SPIF);
+    return SPDR;
 }
 
 void max6675_setup(void)
 {
-    uint8_t i,j;
+    uint8_t i;
 
     // enable SPI; polled; MSB-first; Master; idle: low; sample: div: 32 (.5 MHz clock)
     SPCR    = _BV(SPE) | _BV(MSTR) | _BV(SPR1);
     SPSR    = _BV(SPI2X);
 
-    // set chip-selects inactive and initialize averages
+    // set chip-selects inactive and initialize filters
     for(i=0;i<DEVICES;++i)
     {
         _max6675_select(i,0);
-
-#ifdef TEMP_AVERAGING
-        for(j=0;j<AVERAGE;++j){
-            temps[i][j] = 100; // 25C
-        }
-#endif
+        filter_init(&temps[i],DEFAULT_FILTER_MEDIAN,DEFAULT_FILTER_BITS,100); // 25C
+        tc_value[i]     = 100;
+        tc_fine[i]      = 100 << 2;
+        tc_cj[i]        = 0;
+        tc_faults[i]    = 0;
     }
+    tc_next = 0;
+
+    cal_setup();
 
     // set SPI pin directions
     DDRB    &= ~(_BV(3));       // MISO as input
@@ -93,183 +113,163 @@ void max6675_setup(void)
     // start initial conversion
 void max6675_start(void){
     uint8_t i;
+
+    // pulse every chip-select to restart its conversion, wait for the
+    // slowest one, then take the first readings
     for(i=0;i<DEVICES;i++)
     {
-        _delay_ms(2);
         _max6675_select(i,1);
-        _delay_ms(2);
+        _delay_us(1);
         _max6675_select(i,0);
-        _delay_ms(220);
+    }
+    _delay_ms(220);
+
+    for(i=0;i<DEVICES;i++)
+    {
+        tc_last[i] = stats_now() - tc_conversion[tc_devices[i].type];
+        max6675_poll();
     }
 }
 
-int16_t max6675_read(uint8_t device)
-{ 
+// read and decode one chip; returns the temperature (0.25C) or a fault code
+static int16_t _max6675_convert(uint8_t device)
+{
+    uint32_t raw;
     int16_t result;
-    int16_t avg;
-    
-    cli();
-
-    // clear
-    result=SPIF;
-    result=SPDR;
-    SPDR = 0xFF;
+    uint8_t faults = 0;
 
     _max6675_select(device,1);
-    _delay_ms(2);
 
-    // read MSbyte
+    raw = _spi_byte();
+    raw = (raw << 8) | _spi_byte();
 
-    loop_until_bit_is_set(SPSR,SPIF);
-    result = SPDR;
-    result <<= 8;
-
-    // read LSbyte
-    SPDR = 0xFF;
-    loop_until_bit_is_set(SPSR,SPIF);
-    result |= SPDR;
+    if(tc_devices[device].type == TC_MAX31855)
+    {
+        raw = (raw << 8) | _spi_byte();
+        raw = (raw << 8) | _spi_byte();
+    }
 
     // de-select device (starts new conversion)
     _max6675_select(device,0);
 
-    sei();
+    if(tc_devices[device].type == TC_MAX31855)
+    {
+        // D31..18: thermocouple, signed 0.25C; D16: fault; D15..4: cold
+        // junction, signed 1/16C; D2..0: short to VCC/GND, open
+        if(raw == 0 || raw == 0xFFFFFFFFUL)
+            faults = TC_FAULT_BUS;
+        else if(raw & (1UL<<16))
+            faults = raw & (TC_FAULT_OPEN|TC_FAULT_GND|TC_FAULT_VCC);
+
+        tc_cj[device] = (int16_t)raw >> 4;
+        result = (int32_t)raw >> 18;
+    }
+    else
+    {
+        // result is in upper 13 bits (12 real bits; MSbit is dummy sign (always 0))
+        if(raw == 0x0000 || raw == 0xFFFF)
+            faults = TC_FAULT_BUS;
+        else if(raw & (1<<2))
+            faults = TC_FAULT_OPEN;
 
-    // check for open/shorted line or open-thermocouple flag
-    if( result == 0x0000 || result == 0xFFFF || result & (1<<2) ) {
-        result = 0xFFFF;
-        thermocouple_fault(result);
-        return result;
+        result = raw >> 3;
     }
-    
-    // result is in upper 13 bits (12 real bits; MSbit is dummy sign (always 0))
-    result >>= 3;
 
     // check range (5-300 degrees)
-    if( result < 10 || result > 1200) {
-        thermocouple_fault(result);
-        result = 0x0FFF;
-        return result;
-    }
+    if( !faults && (result < 10 || result > 1200) )
+        faults = TC_FAULT_RANGE;
 
-    // average
-    avg = result;
-    
-#ifdef TEMP_AVERAGING
-    temps[device][0] = result;
+    // report when a fault appears, rather than on every read
+    if(faults && faults != tc_faults[device])
+        thermocouple_fault(faults == TC_FAULT_RANGE ? result : MAX6675_OPEN);
+    tc_faults[device] = faults;
+
+    // check for open/shorted line or open-thermocouple flag
+    if(faults == TC_FAULT_RANGE)    return MAX6675_RANGE;
+    if(faults)                      return MAX6675_OPEN;
 
-    for(uint8_t i=1;i<AVERAGE;i++)
+    // reject spikes and average, then correct with the probe's calibration
+    result = filter_update(&temps[device],result);
+    tc_fine[device] = cal_apply_fine(device,filter_fine(&temps[device]));
+
+    return cal_apply(device,result);
+}
+
+void max6675_poll(void)
+{
+    uint8_t device, intr_state = SREG;
+    uint16_t now;
+
+    cli();
+
+    // one chip per call, round-robin, once its conversion is done
+    device = tc_next;
+    if(++tc_next >= DEVICES) tc_next = 0;
+
+    now = stats_now();
+    if((uint16_t)(now - tc_last[device]) >= tc_conversion[tc_devices[device].type])
     {
-    	avg += temps[device][i];
-        temps[device][i] = temps[device][i-1];
+        tc_last[device]     = now;
+        tc_value[device]    = _max6675_convert(device);
     }
 
-    avg >>= AVERAGE_BITS;
-#endif
-
-// use remap table?
-//   return thermocouple_lookup(avg);
-    
-    return avg;
+    SREG = intr_state;
 }
 
+int16_t max6675_read(uint8_t device)
+{
+    int16_t result;
+    uint8_t intr_state = SREG;
 
-/* The following is necessary to correct unexplained Thermocouple reading skew
- 
- */
+    cli();
+    result = tc_value[device];
+    SREG = intr_state;
 
-#define KEY_TYPE int16_t
-#define VALUE_TYPE int16_t
+    return result;
+}
 
-typedef struct {
- KEY_TYPE k;
- VALUE_TYPE v;
-} lut2_bs_kvp;
+int16_t max6675_read_fine(uint8_t device)
+{
+    int16_t result;
+    uint8_t intr_state = SREG;
 
+    cli();
+    result = tc_fine[device];
+    SREG = intr_state;
 
-/*generated by LUTGenerator
- Input is Raw Thermocouple in CX4. Output is corrected Temp in C/2
- * (Overall calibration for thermocouple that's ~6% hot)
- */
+    return result;
+}
 
-static const lut2_bs_kvp thermocouple_lut_data[] = {
-    {0, 0}, {400, 200}, {420, 210}, {530, 217}, {600, 302}, {660, 333}, {1000, 503}
-};
+int16_t max6675_cold_junction(uint8_t device)
+{
+    int16_t result;
+    uint8_t intr_state = SREG;
 
+    cli();
+    result = tc_cj[device];
+    SREG = intr_state;
 
+    return result;
+}
 
+uint8_t max6675_faults(uint8_t device)
+{
+    return tc_faults[device];
+}
 
-#define LUT_READ_K(idx) (KEY_TYPE) thermocouple_lut_data[idx].k
-#define LUT_READ_V(idx) (VALUE_TYPE) (thermocouple_lut_data[idx].v<<1)
-
-#define LOOKUP_ABS(x,y) ((x>=y) ? x-y : y-x )
-#define LUT_LENGTH 7
-
-#define MAX(a,b) ((a>b) ? a: b )
-
-
-VALUE_TYPE thermocouple_lookup(KEY_TYPE x){ 
-    uint8_t low=0,
-            high=LUT_LENGTH-1,            
-            search_marker=(LUT_LENGTH-1)>>1;
-    
-    KEY_TYPE k;  
-    if (x<0) return x; // preserve error code
-    if (x>1000) return x;
-    
-    while (high-low>1){
-        
-        k=LUT_READ_K(search_marker);
-        // exact match
-        if (k==x){
-            return (VALUE_TYPE)LUT_READ_V(search_marker)<<2;            
-        }
-        
-        if (k>x){
-            high=search_marker;
-            search_marker=high-MAX((high-low)>>1,1);    
-        } else {
-            low=search_marker;
-            search_marker=low+MAX((high-low)>>1,1);    
-        }
-    }
+void max6675_set_filter(uint8_t median, uint8_t bits)
+{
+    uint8_t i, intr_state = SREG;
 
-    
-    // check search marker one last time
-    k=LUT_READ_K(search_marker);
-    // exact match
-    if (k==x){
-            return (VALUE_TYPE)LUT_READ_V(search_marker)<<2;            
-    }
+    // restart each filter from its current output so there's no step
+    cli();
+    for(i=0;i<DEVICES;++i)
+        filter_init(&temps[i],median,bits,temps[i].out);
+    SREG = intr_state;
+}
 
-    
-    // interpolate between high and low with fixed point math    
-    // = l.v + (X-l.k) * (h.v-l.v)/(h.k-l.k)
-    
-    KEY_TYPE lk=LUT_READ_K(low),
-             hk=LUT_READ_K(high);    
-    VALUE_TYPE lv=LUT_READ_V(low),
-            hv=LUT_READ_V(high);
-    
-    KEY_TYPE tb=LOOKUP_ABS(hk,lk); // temporarily store bottom in tb
-        
-    if (tb!=0){
-        
-        // need the extra res to avoid overflows
-        int32_t temp_tb=LOOKUP_ABS(x,lk);
-        
-        temp_tb*=LOOKUP_ABS(hv,lv);
-        temp_tb/=tb;
-        
-        tb=temp_tb;
-        
-        // original math:
-        //tb=(LOOKUP_ABS(x,lk)* LOOKUP_ABS(hv,lv))/tb;        
-    } else {
-        tb=0;
-    }
-    
-    
-// never negative!    
-        return ((VALUE_TYPE)lv)+tb;
-       
-}
\ No newline at end of file
+void max6675_get_filter(uint8_t *median, uint8_t *bits)
+{
+    *median = temps[0].median;
+    *bits   = temps[0].bits;
+}
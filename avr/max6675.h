@@ -35,12 +35,44 @@ extern "C"{
 
 #include <stdint.h>
 
+// thermocouple converter types (TC_TABLE in ovencon.h)
+#define TC_MAX6675      0   // 12 bit, 0-1024C, 220ms conversion
+#define TC_MAX31855     1   // 14 bit signed with cold junction, 100ms conversion
+
+// fault bits from max6675_faults() (the low three match the MAX31855)
+#define TC_FAULT_OPEN   0x01    // open thermocouple
+#define TC_FAULT_GND    0x02    // thermocouple shorted to GND
+#define TC_FAULT_VCC    0x04    // thermocouple shorted to VCC
+#define TC_FAULT_BUS    0x08    // all-zeros/all-ones: chip missing or line open
+#define TC_FAULT_RANGE  0x10    // reading outside 2.5-300C
+
+// fault values returned by max6675_read()
+#define MAX6675_OPEN    ((int16_t)0xFFFF)   // open/shorted line or open thermocouple
+#define MAX6675_RANGE   ((int16_t)0x0FFF)   // reading outside 2.5-300C
+
 void max6675_setup(void);
 
 void max6675_start(void);
 
+// reads the next due chip, round-robin; call every half-cycle from the
+// timer interrupt
+void max6675_poll(void);
+
+// latest (filtered) reading of a device, 0.25C, or a fault value
 int16_t max6675_read(uint8_t device);
 
+// mean of the last 4 good readings, 1/16C (held through faults)
+int16_t max6675_read_fine(uint8_t device);
+
+// cold junction temperature, 1/16C (MAX31855 only)
+int16_t max6675_cold_junction(uint8_t device);
+
+uint8_t max6675_faults(uint8_t device);
+
+// median-of-N (1, 3 or 5) spike rejection and 2^bits running average
+void max6675_set_filter(uint8_t median, uint8_t bits);
+void max6675_get_filter(uint8_t *median, uint8_t *bits);
+
 
 
 #ifdef __cplusplus
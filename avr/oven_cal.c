@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_cal.h"
+#include "ovencon.h"
+
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#if DEVICES > CAL_DEVICES
+#error "DEVICES > CAL_DEVICES"
+#endif
+
+typedef struct
+{
+    uint8_t     count;
+    uint8_t     check;
+    int16_t     raw[CAL_POINTS];
+    int16_t     temp[CAL_POINTS];
+} s_cal_eeprom;
+
+static s_cal_eeprom EEMEM cal_eeprom[CAL_DEVICES];
+
+// segment i covers raw >= raw[i]; slope is 8.8 fixed point
+typedef struct
+{
+    int16_t     raw;
+    int16_t     temp;
+    int16_t     slope;
+} s_cal_seg;
+
+static s_cal_seg cal_seg[DEVICES][CAL_POINTS];
+static uint8_t   cal_count[DEVICES];
+
+static uint8_t _cal_check(uint8_t count, const int16_t *raw, const int16_t *temp)
+{
+    uint8_t i, check = 0x5A ^ count;
+
+    for(i=0;i<CAL_POINTS;i++)
+        check ^= (uint8_t)raw[i] ^ (uint8_t)(raw[i] >> 8) ^
+                 (uint8_t)temp[i] ^ (uint8_t)(temp[i] >> 8);
+
+    return check;
+}
+
+static uint8_t _cal_read(uint8_t device, int16_t *raw, int16_t *temp)
+{
+    uint8_t i, count;
+
+    count = eeprom_read_byte(&cal_eeprom[device].count);
+    eeprom_read_block(raw,cal_eeprom[device].raw,sizeof(cal_eeprom[0].raw));
+    eeprom_read_block(temp,cal_eeprom[device].temp,sizeof(cal_eeprom[0].temp));
+
+    // erased (0xFF), corrupt, out of range or not in increasing order: no table
+    if(count < 2 || count > CAL_POINTS ||
+       eeprom_read_byte(&cal_eeprom[device].check) != _cal_check(count,raw,temp))
+        return 0;
+
+    for(i=0;i<count;i++)
+        if(raw[i] < -CAL_LIMIT || raw[i] > CAL_LIMIT ||
+           temp[i] < -CAL_LIMIT || temp[i] > CAL_LIMIT ||
+           (i && raw[i] <= raw[i-1]))
+            return 0;
+
+    return count;
+}
+
+static void _cal_load(uint8_t device)
+{
+    s_cal_seg seg[CAL_POINTS];
+    int16_t raw[CAL_POINTS], temp[CAL_POINTS];
+    int32_t slope;
+    uint8_t i, count, intr_state;
+
+    count = _cal_read(device,raw,temp);
+
+    // precompute the slopes so applying a table is one multiply
+    for(i=0;i<count;i++)
+    {
+        seg[i].raw  = raw[i];
+        seg[i].temp = temp[i];
+
+        if(i+1 < count) {
+            slope = (((int32_t)temp[i+1] - temp[i]) * 256) / ((int32_t)raw[i+1] - raw[i]);
+            if(slope > INT16_MAX) slope = INT16_MAX;
+            if(slope < INT16_MIN) slope = INT16_MIN;
+            seg[i].slope = slope;
+        } else {
+            seg[i].slope = seg[i-1].slope;
+        }
+    }
+
+    intr_state = SREG;
+    cli();
+    for(i=0;i<count;i++)
+        cal_seg[device][i] = seg[i];
+    cal_count[device] = count;
+    SREG = intr_state;
+}
+
+void cal_setup(void)
+{
+    uint8_t i;
+
+    for(i=0;i<DEVICES;i++)
+        _cal_load(i);
+}
+
+int16_t cal_apply_fine(uint8_t device, int16_t fine)
+{
+    const s_cal_seg *seg = cal_seg[device];
+    uint8_t i, count = cal_count[device];
+    int16_t raw = fine >> 2;
+    int32_t result;
+
+    if(count < 2)
+        return fine;
+
+    // below the table: extrapolate the first segment
+    for(i=count-1; i>0 && raw < seg[i].raw; i--)
+        ;
+
+    // extrapolating a steep segment can run past the 16-bit result
+    result = (int32_t)seg[i].temp * 4 +
+        ((((int32_t)fine - seg[i].raw * 4) * seg[i].slope) >> 8);
+    if(result > INT16_MAX) result = INT16_MAX;
+    if(result < INT16_MIN) result = INT16_MIN;
+
+    return result;
+}
+
+int16_t cal_apply(uint8_t device, int16_t raw)
+{
+    return cal_apply_fine(device, raw * 4) >> 2;
+}
+
+void cal_set_point(uint8_t device, uint8_t idx, int16_t raw, int16_t temp)
+{
+    if(device >= CAL_DEVICES || idx >= CAL_POINTS)
+        return;
+
+    eeprom_update_word((uint16_t*)&cal_eeprom[device].raw[idx],raw);
+    eeprom_update_word((uint16_t*)&cal_eeprom[device].temp[idx],temp);
+}
+
+uint8_t cal_save(uint8_t device, uint8_t count)
+{
+    int16_t raw[CAL_POINTS], temp[CAL_POINTS];
+    uint8_t ok = 1;
+
+    // count 0 clears the table
+    if(device >= CAL_DEVICES || count == 1 || count > CAL_POINTS)
+        return 0;
+
+    eeprom_read_block(raw,cal_eeprom[device].raw,sizeof(cal_eeprom[0].raw));
+    eeprom_read_block(temp,cal_eeprom[device].temp,sizeof(cal_eeprom[0].temp));
+
+    eeprom_update_byte(&cal_eeprom[device].count,count);
+    eeprom_update_byte(&cal_eeprom[device].check,_cal_check(count,raw,temp));
+
+    if(count && _cal_read(device,raw,temp) != count)
+    {
+        eeprom_update_byte(&cal_eeprom[device].count,0);
+        ok = 0;
+    }
+
+    if(device < DEVICES)
+        _cal_load(device);
+
+    return ok;
+}
+
+uint8_t cal_get(uint8_t device, int16_t *raw, int16_t *temp)
+{
+    if(device >= CAL_DEVICES)
+        return 0;
+
+    return _cal_read(device,raw,temp);
+}
+
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_CAL_H_INCLUDED
+#define OVEN_CAL_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Per-device thermocouple calibration: up to CAL_POINTS (raw, corrected)
+// pairs, both in 0.25C, kept in EEPROM and applied piecewise-linearly
+// (extrapolating past the ends).  Fewer than two points: no correction.
+// Points are limited to +/-CAL_LIMIT (2047.75C), so they convert to 1/16C.
+
+#define CAL_POINTS      8
+#define CAL_LIMIT       8191
+#define CAL_DEVICES     8   // EEPROM slots, independent of DEVICES
+
+// load every device's table from EEPROM
+void cal_setup(void);
+
+// corrected reading; safe from the timer interrupt
+int16_t cal_apply(uint8_t device, int16_t raw);
+
+// as cal_apply, in 1/16C
+int16_t cal_apply_fine(uint8_t device, int16_t fine);
+
+// EEPROM updates (slow: main loop only).  Points are written one at a time,
+// then cal_save() checks they're in range and in increasing raw order, seals
+// the table and loads it; returns 0 if the table was rejected
+void cal_set_point(uint8_t device, uint8_t idx, int16_t raw, int16_t temp);
+uint8_t cal_save(uint8_t device, uint8_t count);
+
+// stored table (count is 0 if none)
+uint8_t cal_get(uint8_t device, int16_t *raw, int16_t *temp);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
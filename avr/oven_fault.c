@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_fault.h"
+#include "ovencon.h"
+
+
+static uint8_t  fault_mask;                     // ticks left in the start-up mask
+static uint8_t  fault_hist[FAULT_SENSORS];      // last M readings, 1 = bad
+static int16_t  fault_held[FAULT_SENSORS];      // last good reading
+static uint8_t  fault_trip;
+
+void fault_reset(void)
+{
+    uint8_t i;
+
+    fault_mask = FAULT_MASK_TICKS;
+    fault_trip = 0;
+
+    for(i=0;i<FAULT_SENSORS;i++)
+    {
+        fault_hist[i] = 0;
+        fault_held[i] = 100; // 25C until there's a good reading
+    }
+}
+
+void fault_tick(void)
+{
+    if(fault_mask) fault_mask--;
+}
+
+int16_t fault_sensor(uint8_t ch, int16_t reading, uint8_t bad)
+{
+    uint8_t hist, n;
+
+    if(!bad)
+        fault_held[ch] = reading;
+
+    if(fault_mask)
+        return fault_held[ch];
+
+    hist = (fault_hist[ch] << 1) | (bad ? 1 : 0);
+#if FAULT_DEBOUNCE_M < 8
+    hist &= (1 << FAULT_DEBOUNCE_M) - 1;
+#endif
+    fault_hist[ch] = hist;
+
+    for(n = 0; hist; hist >>= 1)
+        n += hist & 1;
+
+    if(n >= FAULT_DEBOUNCE_N)
+        fault_trip |= 1 << ch;
+
+    return fault_held[ch];
+}
+
+uint8_t fault_tripped(void)
+{
+    return fault_trip;
+}
+
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_FAULT_H_INCLUDED
+#define OVEN_FAULT_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Sensor fault manager.  Bad readings are replaced by the last good value;
+// a channel trips once FAULT_DEBOUNCE_N of its last FAULT_DEBOUNCE_M
+// readings were bad.  Nothing is counted during the first FAULT_MASK_TICKS
+// control ticks after a reset, while the converters settle.
+
+#define FAULT_TOP       0
+#define FAULT_BOT       1
+#define FAULT_SENSORS   2
+
+// clear the history and restart the start-up mask
+void fault_reset(void);
+
+// once per control tick, before the sensors are checked
+void fault_tick(void);
+
+// returns the reading, or the last good one if this reading is bad
+int16_t fault_sensor(uint8_t ch, int16_t reading, uint8_t bad);
+
+// bitmask of tripped channels (latched until fault_reset)
+uint8_t fault_tripped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_filter.h"
+
+
+void filter_init(s_filter *f, uint8_t median, uint8_t bits, int16_t value)
+{
+    uint8_t i;
+
+    if(median >= 5)         f->median = 5;
+    else if(median >= 3)    f->median = 3;
+    else                    f->median = 1;
+
+    f->bits = (bits > FILTER_MAX_BITS) ? FILTER_MAX_BITS : bits;
+
+    for(i=0;i<FILTER_MAX_MEDIAN;i++)
+        f->med_buf[i] = value;
+    f->med_idx = 0;
+
+    for(i=0;i<(1<<FILTER_MAX_BITS);i++)
+        f->avg_buf[i] = value;
+    f->avg_sum = (int32_t)value << f->bits;
+    f->avg_idx = 0;
+
+    for(i=0;i<FILTER_FINE_SAMPLES;i++)
+        f->fine_buf[i] = value;
+    f->fine_sum = value * FILTER_FINE_SAMPLES;
+    f->fine_idx = 0;
+
+    f->out = value;
+}
+
+#define SORT2(a,b) do { if((a) > (b)) { int16_t t_ = (a); (a) = (b); (b) = t_; } } while(0)
+
+static int16_t _median3(int16_t a, int16_t b, int16_t c)
+{
+    SORT2(a,b);
+    SORT2(b,c);
+    SORT2(a,b);
+    return b;
+}
+
+static int16_t _median5(const int16_t *v)
+{
+    int16_t a = v[0], b = v[1], c = v[2], d = v[3], e = v[4];
+
+    // partial sorting network: drop the min and max of the first four
+    SORT2(a,b);
+    SORT2(c,d);
+    SORT2(a,c);
+    SORT2(b,d);
+    // a is below three others and d above three others, so neither can be
+    // the median of five; it is the median of what is left
+    return _median3(b,c,e);
+}
+
+int16_t filter_update(s_filter *f, int16_t sample)
+{
+    uint8_t n = f->med_idx;
+
+    // median prefilter over the last f->median raw samples
+    if(f->median > 1)
+    {
+        f->med_buf[n] = sample;
+        if(++n >= f->median) n = 0;
+        f->med_idx = n;
+
+        if(f->median == 3)
+            sample = _median3(f->med_buf[0],f->med_buf[1],f->med_buf[2]);
+        else
+            sample = _median5(f->med_buf);
+    }
+
+    // oversampled sum for the fine output
+    n = f->fine_idx;
+    f->fine_sum += sample - f->fine_buf[n];
+    f->fine_buf[n] = sample;
+    f->fine_idx = (n + 1) & (FILTER_FINE_SAMPLES - 1);
+
+    // running average: swap the oldest sample out of the sum
+    if(f->bits)
+    {
+        n = f->avg_idx;
+        f->avg_sum += sample - f->avg_buf[n];
+        f->avg_buf[n] = sample;
+        if(++n >= (1 << f->bits)) n = 0;
+        f->avg_idx = n;
+
+        sample = f->avg_sum >> f->bits;
+    }
+
+    f->out = sample;
+    return sample;
+}
+
+int16_t filter_fine(const s_filter *f)
+{
+    return f->fine_sum;
+}
+
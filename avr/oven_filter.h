@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_FILTER_H_INCLUDED
+#define OVEN_FILTER_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+#define FILTER_MAX_MEDIAN   5   // median-of-1 (off), 3 or 5
+#define FILTER_MAX_BITS     4   // running average over up to 2^4 samples
+#define FILTER_FINE_SAMPLES 4   // oversampling for filter_fine(): two extra bits
+
+// per-sensor filter state: median-of-N spike rejection followed by a
+// running average kept as a ring buffer plus running sum (O(1) per sample)
+typedef struct
+{
+    uint8_t     median;
+    uint8_t     bits;
+
+    int16_t     med_buf[FILTER_MAX_MEDIAN];
+    uint8_t     med_idx;
+
+    int16_t     avg_buf[1<<FILTER_MAX_BITS];
+    int32_t     avg_sum;
+    uint8_t     avg_idx;
+
+    int16_t     fine_buf[FILTER_FINE_SAMPLES];
+    int16_t     fine_sum;   // of the last 4 median outputs: 1/16C for 0.25C samples
+    uint8_t     fine_idx;
+
+    int16_t     out;        // last output
+} s_filter;
+
+// (re)start the filter with every history slot set to value; out-of-range
+// settings are clamped
+void filter_init(s_filter *f, uint8_t median, uint8_t bits, int16_t value);
+
+int16_t filter_update(s_filter *f, int16_t sample);
+
+// sum of the last FILTER_FINE_SAMPLES spike-filtered samples (independent of
+// the running average): the mean, with two extra bits of resolution
+int16_t filter_fine(const s_filter *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_fmt.h"
+
+
+static const uint32_t fmt_pow10[] PROGMEM = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL
+};
+
+char *fmt_u16(char *p, uint16_t v)
+{
+    static const uint16_t pow10[] PROGMEM = { 10000, 1000, 100, 10 };
+    uint8_t i, started = 0;
+    uint16_t d;
+    char c;
+
+    for(i=0;i<4;i++)
+    {
+        d = pgm_read_word(&pow10[i]);
+        for(c = '0'; v >= d; c++)
+            v -= d;
+
+        if(started || c != '0') {
+            *p++ = c;
+            started = 1;
+        }
+    }
+
+    *p++ = '0' + v;
+    return p;
+}
+
+char *fmt_i16(char *p, int16_t v)
+{
+    if(v < 0) {
+        *p++ = '-';
+        return fmt_u16(p, -(uint16_t)v);
+    }
+
+    return fmt_u16(p, v);
+}
+
+char *fmt_u32(char *p, uint32_t v)
+{
+    uint8_t i, started = 0;
+    uint32_t d;
+    char c;
+
+    // 16 bits is the common case, and cheaper
+    if(v <= 0xFFFF)
+        return fmt_u16(p, v);
+
+    for(i=0;i<9;i++)
+    {
+        d = pgm_read_dword(&fmt_pow10[i]);
+        for(c = '0'; v >= d; c++)
+            v -= d;
+
+        if(started || c != '0') {
+            *p++ = c;
+            started = 1;
+        }
+    }
+
+    *p++ = '0' + v;
+    return p;
+}
+
+char *fmt_str(char *p, const char *s)
+{
+    while(*s)
+        *p++ = *s++;
+    return p;
+}
+
+char *fmt_str_P(char *p, PGM_P s)
+{
+    char c;
+
+    while((c = pgm_read_byte(s++)))
+        *p++ = c;
+    return p;
+}
+
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_fusion.h"
+
+
+// tracker gains (shifts): position 1/4, rate 1/32
+#define FUSION_ALPHA    2
+#define FUSION_BETA     5
+
+// thermistor correction time constant: 2^6 ticks (16s at 4Hz)
+#define FUSION_TRIM     6
+
+static int32_t fusion_t;        // tracked thermocouple temperature
+static int32_t fusion_r;        // tracked rate, per tick
+static int32_t fusion_bias;     // thermistor - thermocouple offset
+
+void fusion_reset(int16_t temp)
+{
+    fusion_t    = (int32_t)temp << 8;
+    fusion_r    = 0;
+    fusion_bias = 0;
+}
+
+void fusion_update(int16_t tc, int16_t therm)
+{
+    int32_t resid;
+
+    // predict
+    fusion_t += fusion_r;
+
+    // correct from the thermocouple
+    if(tc >= 0)
+    {
+        resid       = ((int32_t)tc << 8) - fusion_t;
+        fusion_t   += resid >> FUSION_ALPHA;
+        fusion_r   += resid >> FUSION_BETA;
+    }
+
+    // slowly pull the offset towards the thermistor
+    if(therm >= 0)
+        fusion_bias += (((int32_t)therm << 8) - (fusion_t + fusion_bias)) >> FUSION_TRIM;
+}
+
+int16_t fusion_temp(void)
+{
+    return (fusion_t + fusion_bias + 128) >> 8;
+}
+
+int16_t fusion_rate(void)
+{
+    if(fusion_r > 32767)    return 32767;
+    if(fusion_r < -32767)   return -32767;
+    return fusion_r;
+}
+
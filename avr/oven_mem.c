@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <avr/io.h>
+#include "oven_mem.h"
+
+
+// from the linker script
+extern uint8_t __data_start, __data_end, __bss_start, __bss_end;
+extern uint8_t _end, __stack;
+
+#define MEM_PAINT   0xC5
+
+// runs before the C runtime has set up the stack pointer or zero register,
+// so no C here: fill _end..__stack with MEM_PAINT
+void mem_paint(void) __attribute__((naked, used, section(".init1")));
+void mem_paint(void)
+{
+    __asm volatile(
+        "    ldi r30, lo8(_end)      \n"
+        "    ldi r31, hi8(_end)      \n"
+        "    ldi r24, %0             \n"
+        "    ldi r25, hi8(__stack)   \n"
+        "    rjmp 2f                 \n"
+        "1:  st Z+, r24              \n"
+        "2:  cpi r30, lo8(__stack)   \n"
+        "    cpc r31, r25            \n"
+        "    brlo 1b                 \n"
+        "    breq 1b                 \n"
+        :: "i" (MEM_PAINT));
+}
+
+void mem_info(s_mem_info *info)
+{
+    const uint8_t *p = &_end;
+    uint16_t sp = SP;
+
+    info->data      = &__data_end - &__data_start;
+    info->bss       = &__bss_end - &__bss_start;
+    info->stack     = &__stack - &_end + 1;
+    info->free_now  = sp - (uint16_t)(uintptr_t)&_end + 1;
+
+    // the paint runs up from the top of static RAM to the deepest the stack
+    // has been
+    while(p <= &__stack && *p == MEM_PAINT)
+        p++;
+    info->free_min  = p - &_end;
+}
+
@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_monitor.h"
+#include "ovencon.h"
+
+
+#define N       MONITOR_WINDOW
+
+// least-squares constants for x = 0..N-1
+#define SUM_X   ((int32_t)N*(N-1)/2)
+#define SUM_XX  ((int32_t)(N-1)*N*(2*N-1)/6)
+#define DEN     ((int32_t)N*SUM_XX - SUM_X*SUM_X)
+
+static int16_t  mon_temp[N];
+static uint8_t  mon_power[N];
+static uint8_t  mon_idx;        // oldest sample
+static uint8_t  mon_fill;
+
+static int32_t  mon_sum_y;      // sum of temps
+static int32_t  mon_sum_xy;     // sum of x*temp, x=0 for the oldest sample
+static uint16_t mon_sum_p;      // sum of powers
+
+static uint16_t mon_gain;
+static uint8_t  mon_loss;
+
+static int16_t  mon_slope;
+static int16_t  mon_expected;
+static uint8_t  mon_avg_p;
+static uint8_t  mon_bad_heat;
+static uint8_t  mon_bad_run;
+
+void monitor_setup(void)
+{
+    monitor_set_model(DEFAULT_MONITOR_GAIN,DEFAULT_MONITOR_LOSS);
+    monitor_reset();
+}
+
+void monitor_set_model(uint16_t gain, uint8_t loss)
+{
+    mon_gain    = gain;
+    mon_loss    = loss;
+}
+
+void monitor_get_model(uint16_t *gain, uint8_t *loss)
+{
+    *gain       = mon_gain;
+    *loss       = mon_loss;
+}
+
+void monitor_reset(void)
+{
+    mon_idx         = 0;
+    mon_fill        = 0;
+    mon_sum_y       = 0;
+    mon_sum_xy      = 0;
+    mon_sum_p       = 0;
+    mon_slope       = 0;
+    mon_expected    = 0;
+    mon_avg_p       = 0;
+    mon_bad_heat    = 0;
+    mon_bad_run     = 0;
+}
+
+uint8_t monitor_update(int16_t temp, uint8_t power)
+{
+    int16_t out_y;
+    uint8_t avg_p;
+    int32_t expected;
+
+    if(mon_fill < N)
+    {
+        // still filling: the new sample lands at x = mon_fill
+        mon_temp[mon_fill]  = temp;
+        mon_power[mon_fill] = power;
+        mon_sum_xy         += (int32_t)mon_fill * temp;
+        mon_sum_y          += temp;
+        mon_sum_p          += power;
+
+        if(++mon_fill < N)
+            return MONITOR_OK;
+    }
+    else
+    {
+        // slide the window: every x drops by one, the oldest sample leaves
+        // and the new one comes in at x = N-1
+        out_y       = mon_temp[mon_idx];
+        mon_sum_xy += out_y - mon_sum_y + (int32_t)(N-1) * temp;
+        mon_sum_y  += temp - out_y;
+        mon_sum_p  += power - mon_power[mon_idx];
+
+        mon_temp[mon_idx]   = temp;
+        mon_power[mon_idx]  = power;
+        if(++mon_idx >= N) mon_idx = 0;
+    }
+
+    // slope in 0.25C per 0.25s tick (= C/s), scaled to 1/256 C/s
+    mon_slope = (N*mon_sum_xy - SUM_X*mon_sum_y) / (DEN >> 8);
+
+    // first-order model: heating in proportion to power, losses in proportion
+    // to the rise above ambient
+    // (in 32 bits: both are set by the host)
+    avg_p       = mon_sum_p / N;
+    expected    = ((int32_t)mon_gain * avg_p) / 255 -
+                  ((((int32_t)temp - MONITOR_AMBIENT) * mon_loss) >> 4);
+    if(expected > INT16_MAX) expected = INT16_MAX;
+    if(expected < INT16_MIN) expected = INT16_MIN;
+    mon_expected = expected;
+    mon_avg_p   = avg_p;
+
+    // heating hard but the sensor barely moves
+    if(avg_p >= 128 && mon_expected >= MONITOR_MIN_RISE && mon_slope < (mon_expected >> 2)) {
+        if(mon_bad_heat < 255) mon_bad_heat++;
+    } else {
+        mon_bad_heat = 0;
+    }
+
+    // heating off but the temperature keeps climbing
+    if(avg_p <= 8 && mon_slope > MONITOR_RUNAWAY_RISE) {
+        if(mon_bad_run < 255) mon_bad_run++;
+    } else {
+        mon_bad_run = 0;
+    }
+
+    if(mon_bad_heat >= MONITOR_HOLD)    return MONITOR_NO_RESPONSE;
+    if(mon_bad_run >= MONITOR_HOLD)     return MONITOR_RUNAWAY;
+
+    return MONITOR_OK;
+}
+
+int16_t monitor_slope(void)
+{
+    return mon_slope;
+}
+
+int16_t monitor_expected(void)
+{
+    return mon_expected;
+}
+
+uint8_t monitor_power(void)
+{
+    return mon_avg_p;
+}
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_MONITOR_H_INCLUDED
+#define OVEN_MONITOR_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Thermal plausibility monitor.  The observed temperature slope (rolling
+// least-squares fit over the last MONITOR_WINDOW control ticks) is compared
+// against what a first-order oven model expects from the applied power;
+// sustained disagreement means the sensor has come off (no response to
+// power) or an element is stuck on (rising with no power).
+
+#define MONITOR_OK          0
+#define MONITOR_NO_RESPONSE 1
+#define MONITOR_RUNAWAY     2
+
+// model defaults, then monitor_reset
+void monitor_setup(void);
+void monitor_reset(void);
+
+// the oven model (see MONITOR_* in ovencon.h): gain in 1/256 C/s at full
+// power, loss in 1/256 C/s per 4C above ambient
+void monitor_set_model(uint16_t gain, uint8_t loss);
+void monitor_get_model(uint16_t *gain, uint8_t *loss);
+
+// once per control tick: temperature (0.25C units) and applied power (0-255)
+uint8_t monitor_update(int16_t temp, uint8_t power);
+
+int16_t monitor_slope(void);      // observed, 1/256 C/s
+int16_t monitor_expected(void);   // model, 1/256 C/s
+uint8_t monitor_power(void);      // average over the window, 0-255
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
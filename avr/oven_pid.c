@@ -32,35 +32,53 @@ volatile uint8_t k_i;
 volatile uint8_t k_d;
 
 const uint8_t k_div = 9;
-#define k_delay 40
+
+#define PID_SLOPE_DEN   (2L*(PID_SLOPE_WINDOW-1)*PID_SLOPE_WINDOW*(PID_SLOPE_WINDOW+1)/3)
 
 // state
-int16_t pid_prev[k_delay]; // previous temperatures (0.25C units)
+int16_t pid_hist[PID_SLOPE_WINDOW]; // recent temperatures (1/16C units)
 int32_t pid_int; // integral
 
-uint8_t pid_prev_index;
-
-int16_t pid_prev_update(int16_t prev)
-{
-    int16_t popped = pid_prev[pid_prev_index];
-    pid_prev[pid_prev_index] = prev;
-
-    pid_prev_index++;
-    if(pid_prev_index >= k_delay)
-        pid_prev_index = 0;
-
-    return popped;
-}
+uint8_t pid_hist_index;
 
 void pid_reset(void)
 {
     uint8_t i;
     
-    for(i=0;i<k_delay;i++)
-        pid_prev[i] = 100; // room temp
+    for(i=0;i<PID_SLOPE_WINDOW;i++)
+        pid_hist[i] = 100 << 2; // room temp
     
     pid_int = 0;
-    pid_prev_index = 0;
+    pid_hist_index = 0;
+}
+
+// least-squares slope of the last PID_SLOPE_WINDOW temperatures, as the fall
+// over PID_DERIVATIVE_STEPS steps in 0.25C units (the scale k_d was tuned for)
+static int16_t pid_slope_update(int16_t fine)
+{
+    uint8_t i, n;
+    int32_t sum = 0, slope;
+
+    pid_hist[pid_hist_index] = fine;
+    if(++pid_hist_index >= PID_SLOPE_WINDOW)
+        pid_hist_index = 0;
+
+    // weights 2x-(N-1) for x = 0 (oldest) .. N-1, i.e. -7,-5,..,7 for N = 8
+    n = pid_hist_index;
+    for(i=0;i<PID_SLOPE_WINDOW;i++)
+    {
+        sum += (int32_t)(2*i - (PID_SLOPE_WINDOW-1)) * pid_hist[n];
+        if(++n >= PID_SLOPE_WINDOW) n = 0;
+    }
+
+    // slope (1/16C per step) = 2*sum/(sum of squared weights); times steps,
+    // and /4 for 0.25C units.  A step across the whole range doesn't fit 16
+    // bits, so saturate
+    slope = -((sum * PID_DERIVATIVE_STEPS) / PID_SLOPE_DEN);
+    if(slope > INT16_MAX) slope = INT16_MAX;
+    if(slope < INT16_MIN) slope = INT16_MIN;
+
+    return slope;
 }
 
 // input is current temperature and target temperature (in 0.25C units)
@@ -68,27 +86,72 @@ void pid_reset(void)
 // PID algorithm based on information presented in Tim Wescott's "PID wihout a PhD" article
 uint8_t pid_update(int16_t temp, int16_t target)
 {
-    int16_t error, derivative;
+    return pid_update_fine(temp << 2, target);
+}
+
+// as pid_update, with the temperature in 1/16C units; the extra resolution
+// lets the derivative use a short window instead of a long delay
+uint8_t pid_update_fine(int16_t fine, int16_t target)
+{
+    // derivative term must be negative when we're ramping up
+    return pid_update_d((fine + 2) >> 2, target, pid_slope_update(fine));
+}
+
+void pid_set_gains(uint8_t p, uint8_t i, uint8_t d)
+{
+    k_p = (p > PID_MAX_SHIFT) ? PID_MAX_SHIFT : p;
+    k_i = (i > PID_MAX_SHIFT) ? PID_MAX_SHIFT : i;
+    k_d = (d > PID_MAX_SHIFT) ? PID_MAX_SHIFT : d;
+}
+
+// x << k, saturated to +/-PID_TERM_MAX so the sum of the three terms can't
+// overflow; that's still far past the 0-255 command after the post-divide,
+// so a saturated term only ever means a saturated output
+#define PID_TERM_MAX    ((int32_t)1 << 29)
+
+static int32_t pid_term(int32_t x, uint8_t k)
+{
+    if(x > (PID_TERM_MAX >> k))
+        return PID_TERM_MAX;
+    if(x < -(PID_TERM_MAX >> k))
+        return -PID_TERM_MAX;
+
+    // (shifting the unsigned value: a negative left shift is undefined)
+    return (int32_t)((uint32_t)x << k);
+}
+
+// as pid_update, with the derivative supplied by the caller (temperature fall
+// over PID_DERIVATIVE_STEPS steps, in 0.25C units)
+uint8_t pid_update_d(int16_t temp, int16_t target, int16_t derivative)
+{
+    int32_t error;
     int32_t command;
 
     // calculate terms
-    error       = target - temp; // error term must be positive when we're ramping up
-    derivative  = pid_prev_update(temp) - temp; // derivative term must be negative when we're ramping up
+    error       = (int32_t)target - temp; // error term must be positive when we're ramping up
 
     // TODO: consider using derivative of error, rather than temp
 
     // sum weighted terms
-    command     = ((int32_t)error)      << k_p;
-    command    += ((int32_t)pid_int)    << k_i;
-    command    += ((int32_t)derivative) << k_d;
+    command     = pid_term(error,k_p);
+    command    += pid_term(pid_int,k_i);
+    command    += pid_term(derivative,k_d);
 
     // post-divide
     command   >>= k_div;
 
     // only update integral if output is not saturated (or if change would reduce saturation)
     if( (command >= 0 && command <= 255) || (command > 0 && error < 0) || (command < 0 && error > 0) )
+    {
         pid_int     += error;
 
+        // past this, the integral term is saturated at any gain
+        if(pid_int > PID_TERM_MAX)
+            pid_int     = PID_TERM_MAX;
+        else if(pid_int < -PID_TERM_MAX)
+            pid_int     = -PID_TERM_MAX;
+    }
+
     // limit command
     if(command < 0)
         command     = 0;
@@ -36,6 +36,20 @@ extern "C"{
 
 void pid_reset(void);
 uint8_t pid_update(int16_t temp, int16_t target);
+uint8_t pid_update_fine(int16_t fine, int16_t target);
+uint8_t pid_update_d(int16_t temp, int16_t target, int16_t derivative);
+
+// gains are shifts (see pid_update_d), limited to PID_MAX_SHIFT; the
+// shifted terms saturate rather than overflow at any gain
+#define PID_MAX_SHIFT 16
+void pid_set_gains(uint8_t p, uint8_t i, uint8_t d);
+
+// the derivative term is scaled as the temperature change over this many
+// steps (k_d was tuned against a 10s delay line)
+#define PID_DERIVATIVE_STEPS 40
+
+// steps in the least-squares derivative fit (2s)
+#define PID_SLOPE_WINDOW 8
 
 #ifdef __cplusplus
 }
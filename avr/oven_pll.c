@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_pll.h"
+
+
+// timer ticks per microsecond (clk/8); signed, or the lock window
+// comparison below is done unsigned and never passes
+#define TICKS_PER_US    ((int16_t)(F_CPU/8000000))
+
+// PLL tuning; gains are shifts: the period is adjusted by err/2^ZC_KP + sum(err)/2^ZC_KI
+#define ZC_KP           2
+#define ZC_KI           6
+#define ZC_RANGE        (pll->nominal >> 6)     // +/-1.5% pull range around the nominal period
+#define ZC_LOCK_WINDOW  (150 * TICKS_PER_US)    // |phase error| considered in-lock
+#define ZC_LOCK_COUNT   16                      // consecutive in-window edges required to declare lock
+#define ZC_TIMEOUT      8                       // timer periods without an edge before the PLL gives up
+
+void pll_reset(s_pll *pll, uint16_t nominal)
+{
+    pll->nominal    = nominal;
+    pll->period     = nominal;
+    pll->integ      = 0;
+    pll->phase_err  = 0;
+    pll->good       = 0;
+    pll->missed     = 0;
+    pll->locked     = 0;
+}
+
+void pll_edge(s_pll *pll, uint16_t count, uint16_t top)
+{
+    int16_t err, adj, limit;
+    int32_t integ;
+
+    // wrap to +/- half a period (of top+1 ticks); positive means the timer
+    // wrapped early
+    err = (count > (top >> 1)) ? (int16_t)(count - top) - 1 : (int16_t)count;
+
+    // (summed wide: at 16 MHz/50 Hz the limit plus half a period passes 2^15)
+    limit = ZC_RANGE << ZC_KI;
+    integ = (int32_t)pll->integ + err;
+    if(integ > limit)           integ = limit;
+    else if(integ < -limit)     integ = -limit;
+    pll->integ = integ;
+
+    adj = (err >> ZC_KP) + (pll->integ >> ZC_KI);
+    if(adj > (int16_t)ZC_RANGE)         adj = ZC_RANGE;
+    else if(adj < -(int16_t)ZC_RANGE)   adj = -ZC_RANGE;
+
+    pll->period     = pll->nominal + adj;
+    pll->phase_err  = err;
+    pll->missed     = 0;
+
+    if(err < ZC_LOCK_WINDOW && err > -ZC_LOCK_WINDOW) {
+        if(pll->good < ZC_LOCK_COUNT)   pll->good++;
+        else                            pll->locked = 1;
+    } else {
+        pll->good   = 0;
+        pll->locked = 0;
+    }
+}
+
+uint8_t pll_period_elapsed(s_pll *pll)
+{
+    if(pll->missed < ZC_TIMEOUT) {
+        pll->missed++;
+    } else if(pll->locked || pll->period != pll->nominal) {
+        // lost the mains signal; fall back to free-running
+        pll_reset(pll,pll->nominal);
+        return 1;
+    }
+    return 0;
+}
+
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_PLL_H_INCLUDED
+#define OVEN_PLL_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Zero-cross PLL: steers the Timer1 period so the timer wraps on the mains
+// zero-cross.  No hardware access here; oven_timing feeds it from the INT0
+// and compare-match interrupts (and the host tests feed it simulated edges).
+
+typedef struct
+{
+    uint16_t    nominal;    // TOP with no correction (a period is TOP+1 timer ticks)
+    uint16_t    period;     // TOP to apply at the next compare match
+    int16_t     integ;      // integral of phase error
+    int16_t     phase_err;  // last phase error (timer ticks; positive: timer is early)
+    uint8_t     good;       // consecutive in-window edges
+    uint8_t     missed;     // timer periods since the last edge
+    uint8_t     locked;
+} s_pll;
+
+void pll_reset(s_pll *pll, uint16_t nominal);
+
+// a zero-cross edge, count timer ticks after the timer last wrapped, while
+// ICR1 (TOP) was top
+void pll_edge(s_pll *pll, uint16_t count, uint16_t top);
+
+// once per timer period; returns 1 when the edges have stopped and the PLL
+// has fallen back to the nominal period
+uint8_t pll_period_elapsed(s_pll *pll);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
@@ -94,3 +94,13 @@ uint8_t profile_update(volatile int16_t *target)
     return 0;
 }
 
+uint8_t profile_get_step(uint8_t i, uint16_t *delta_time, int16_t *temp_rate, uint8_t *fan_pwm)
+{
+    if(i >= STEPS)
+        return 0;
+
+    *delta_time = profile[i].delta_time;
+    *temp_rate  = profile[i].temp_rate;
+    *fan_pwm    = profile[i].fan_pwm;
+    return 1;
+}
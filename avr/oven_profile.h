@@ -37,6 +37,9 @@ extern "C"{
 void profile_reset(void);
 uint8_t profile_update(volatile int16_t *target);
 
+// read back step i of the profile table; returns 0 past the last step
+uint8_t profile_get_step(uint8_t i, uint16_t *delta_time, int16_t *temp_rate, uint8_t *fan_pwm);
+
 
 
 #ifdef __cplusplus
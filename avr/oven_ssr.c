@@ -25,48 +25,19 @@
  */
 
 #include <avr/io.h>
-#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include <string.h>
 #include "oven_ssr.h"
-
-// generated by equpulse.py
-const uint8_t ssr_profile[32][30] PROGMEM =
-{
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, // 0
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0 }, // 1
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0 }, // 2
-    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0 }, // 3
-    { 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1, 0 }, // 4
-    { 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0 }, // 5
-    { 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0 }, // 6
-    { 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0 }, // 7
-    { 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0 }, // 8
-    { 0, 0, 1, 0, 0, 1, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1 }, // 9
-    { 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0 }, // 10
-    { 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0, 1 }, // 11
-    { 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0 }, // 12
-    { 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 }, // 13
-    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0 }, // 14
-    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 1 }, // 15
-    { 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0 }, // 15 (shifted duplicate to get 32 entries)
-    { 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 1 }, // 16
-    { 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0 }, // 17
-    { 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 1, 0, 0, 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 1 }, // 18
-    { 1, 0, 1, 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 0 }, // 19
-    { 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1 }, // 20
-    { 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 1, 0, 0 }, // 21
-    { 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1 }, // 22
-    { 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1 }, // 23
-    { 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1 }, // 24
-    { 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1 }, // 25
-    { 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 0, 1 }, // 26
-    { 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1 }, // 27
-    { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1 }, // 28
-    { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1 }, // 29
-    { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 }  // 30
-};
+#include "oven_timing.h"
+#include "ovencon.h"
 
 volatile uint8_t ssr_shutdown = 1;
 
+// output watchdog: ssr_set() (once per control tick) reloads this; if it
+// runs out, the control loop has stopped and the outputs are latched off
+static volatile uint8_t ssr_fresh;
+static volatile uint8_t ssr_stale;
+
 #define SSR_PIN_TOP 6
 #define SSR_PIN_BOTTOM 7
 
@@ -90,27 +61,121 @@ static void _ssr_output(uint8_t top, uint8_t bot)
 
 }
 
-uint8_t ssr_top_idx;
-uint8_t ssr_bot_idx;
+// on-times are spread evenly over a window of ssr_window half-cycles by
+// accumulating the on-count every half-cycle and switching on each time it
+// wraps (Bresenham-style), so any window length works without a lookup table
+static uint8_t  ssr_window;
+static uint16_t ssr_top_acc;
+static uint16_t ssr_bot_acc;
 
-volatile uint8_t ssr_top_val;
+volatile uint8_t ssr_top_val; // half-cycles on per window
 volatile uint8_t ssr_bot_val;
 
+// peak-current limiting: on-cycles that would exceed ssr_max_on elements in
+// one half-cycle are owed and paid back in later half-cycles of the window,
+// so average power is preserved whenever the combined demand fits the limit
+static uint8_t  ssr_max_on;     // 0: unlimited
+static uint8_t  ssr_top_owed;
+static uint8_t  ssr_bot_owed;
+static uint8_t  ssr_prefer_bot; // tie-break between equally-owed elements
+
+static s_ssr_peak_stats ssr_peak;
+
+// energy metering: half-cycles each element has actually been energised
+static uint32_t ssr_on_cycles[SSR_CHANNELS];
+static uint16_t ssr_watts[SSR_CHANNELS];
+
 void ssr_setup(void)
 {
     DDRD|=_BV(SSR_PIN_TOP)|_BV(SSR_PIN_BOTTOM);
     ssr_shutdown = 0;
+    ssr_fresh = SSR_WATCHDOG_HALF_CYCLES;
+    ssr_stale = 0;
     _ssr_output(0,0);
-    ssr_top_idx = 0;
-    ssr_bot_idx = 1; // shift by half of an AC cycle
+    ssr_top_val = 0;
+    ssr_bot_val = 0;
+    ssr_prefer_bot = 0;
+    ssr_set_max_on(DEFAULT_SSR_MAX_ON);
+    ssr_set_watts(DEFAULT_WATTS_TOP,DEFAULT_WATTS_BOT);
+    ssr_on_cycles[SSR_TOP] = 0;
+    ssr_on_cycles[SSR_BOT] = 0;
+    ssr_set_window(1); // real window is set up by timing_setup()
+}
+
+void ssr_set_window(uint8_t window)
+{
+    ssr_window  = window;
+    ssr_top_acc = 0;
+    ssr_bot_acc = window >> 1; // stagger bottom against top
+    ssr_top_owed = 0;
+    ssr_bot_owed = 0;
+
+    // on-counts for the old window are meaningless; next ssr_set() refills them
     ssr_top_val = 0;
     ssr_bot_val = 0;
 }
 
 void ssr_set(uint8_t top, uint8_t bot)
 {
-    ssr_top_val = top >> 3; // 0-31
-    ssr_bot_val = bot >> 3; // 0-31
+    // scale 0-255 command to 0-ssr_window half-cycles (rounded)
+    ssr_top_val = ((uint16_t)top * ssr_window + 127) / 255;
+    ssr_bot_val = ((uint16_t)bot * ssr_window + 127) / 255;
+    ssr_fresh   = SSR_WATCHDOG_HALF_CYCLES;
+}
+
+void ssr_set_max_on(uint8_t max_on)
+{
+    uint8_t intr_state = SREG;
+
+    cli();
+    ssr_max_on = max_on;
+    memset(&ssr_peak,0,sizeof(ssr_peak));
+    SREG = intr_state;
+}
+
+void ssr_get_peak_stats(s_ssr_peak_stats *stats)
+{
+    uint8_t intr_state = SREG;
+
+    cli();
+    *stats = ssr_peak;
+    SREG = intr_state;
+}
+
+uint8_t ssr_get_max_on(void)
+{
+    return ssr_max_on;
+}
+
+void ssr_set_watts(uint16_t top, uint16_t bot)
+{
+    ssr_watts[SSR_TOP] = top;
+    ssr_watts[SSR_BOT] = bot;
+}
+
+uint16_t ssr_get_watts(uint8_t ch)
+{
+    return ssr_watts[ch];
+}
+
+uint32_t ssr_get_on_cycles(uint8_t ch)
+{
+    uint32_t cycles;
+    uint8_t intr_state = SREG;
+
+    cli();
+    cycles = ssr_on_cycles[ch];
+    SREG = intr_state;
+
+    return cycles;
+}
+
+uint32_t ssr_energy_wh(uint8_t ch, uint32_t cycles)
+{
+    uint32_t sec = cycles / (2 * timing_mains_hz()); // seconds energised
+
+    // sec*W/3600, split so that neither product overflows 32 bits
+    return (sec / 3600) * ssr_watts[ch] + ((sec % 3600) * ssr_watts[ch]) / 3600;
 }
 
 void ssr_fault(void)
@@ -119,21 +184,85 @@ void ssr_fault(void)
     _ssr_output(0,0);
 }
 
+uint8_t ssr_watchdog_tripped(void)
+{
+    return ssr_stale;
+}
+
+void ssr_clear_fault(void)
+{
+    uint8_t intr_state = SREG;
+
+    cli();
+    ssr_fresh       = SSR_WATCHDOG_HALF_CYCLES;
+    ssr_stale       = 0;
+    ssr_shutdown    = 0;
+    SREG = intr_state;
+}
+
 void ssr_update(void)
 {
-    uint8_t top, bot;
+    uint8_t top, bot, on;
 
-    top = pgm_read_byte( &(ssr_profile[ssr_top_val][ssr_top_idx]) );
-    bot = pgm_read_byte( &(ssr_profile[ssr_bot_val][ssr_bot_idx]) );
+    if(ssr_fresh) {
+        ssr_fresh--;
+    } else if(!ssr_stale) {
+        ssr_stale = 1;
+        ssr_fault();
+    }
 
-    _ssr_output(top,bot);
+    ssr_top_acc += ssr_top_val;
+    if(ssr_top_acc >= ssr_window) {
+        ssr_top_acc -= ssr_window;
+        ssr_top_owed++;
+    }
 
-    if(ssr_top_idx >= 29)   ssr_top_idx = 0;
-    else                    ssr_top_idx++;
+    ssr_bot_acc += ssr_bot_val;
+    if(ssr_bot_acc >= ssr_window) {
+        ssr_bot_acc -= ssr_window;
+        ssr_bot_owed++;
+    }
+
+    // debt only builds when combined demand exceeds the limit; cap it so the
+    // output doesn't keep running long after the command drops
+    if(ssr_top_owed > ssr_window) {
+        ssr_top_owed = ssr_window;
+        ssr_peak.dropped++;
+    }
+    if(ssr_bot_owed > ssr_window) {
+        ssr_bot_owed = ssr_window;
+        ssr_peak.dropped++;
+    }
+
+    top = (ssr_top_owed != 0);
+    bot = (ssr_bot_owed != 0);
+
+    if(ssr_max_on && top + bot > ssr_max_on) {
+        // serve whichever element is further behind; alternate on ties
+        if(ssr_top_owed > ssr_bot_owed || (ssr_top_owed == ssr_bot_owed && !ssr_prefer_bot)) {
+            bot = 0;
+            ssr_prefer_bot = 1;
+        } else {
+            top = 0;
+            ssr_prefer_bot = 0;
+        }
+        ssr_peak.deferred++;
+    }
+
+    if(top) ssr_top_owed--;
+    if(bot) ssr_bot_owed--;
+
+    _ssr_output(top,bot);
 
-    if(ssr_bot_idx >= 29)   ssr_bot_idx = 0;
-    else                    ssr_bot_idx++;
+    on = 0;
+    if(!ssr_shutdown) {
+        if(top) { on++; ssr_on_cycles[SSR_TOP]++; }
+        if(bot) { on++; ssr_on_cycles[SSR_BOT]++; }
+    }
 
+    ssr_peak.on_hist[on]++;
+    if(on > ssr_peak.max_on)
+        ssr_peak.max_on = on;
 }
 
 #define FAN_PIN 7
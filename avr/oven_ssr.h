@@ -35,10 +35,37 @@ extern "C"{
 
 #include <stdint.h>
 
+#define SSR_TOP         0
+#define SSR_BOT         1
+#define SSR_CHANNELS    2
+
+// peak-current statistics (half-cycle counts)
+typedef struct
+{
+    uint32_t    on_hist[3]; // half-cycles with 0, 1 and 2 elements on
+    uint32_t    deferred;   // half-cycles where the limit pushed an on-cycle back
+    uint32_t    dropped;    // on-cycles lost because demand exceeded the limit
+    uint8_t     max_on;     // most elements on in any one half-cycle
+} s_ssr_peak_stats;
+
 void ssr_setup(void);
 void ssr_update(void);
 void ssr_set(uint8_t top, uint8_t bot);
+void ssr_set_window(uint8_t window); // half-cycles per modulation window
 void ssr_fault(void);
+void ssr_clear_fault(void);
+uint8_t ssr_watchdog_tripped(void); // control tick stopped refreshing the outputs
+
+// limit the number of elements on in any half-cycle (0: unlimited); resets stats
+void ssr_set_max_on(uint8_t max_on);
+uint8_t ssr_get_max_on(void);
+void ssr_get_peak_stats(s_ssr_peak_stats *stats);
+
+// energy metering
+void ssr_set_watts(uint16_t top, uint16_t bot);          // element ratings
+uint16_t ssr_get_watts(uint8_t ch);
+uint32_t ssr_get_on_cycles(uint8_t ch);                 // half-cycles energised since power-up
+uint32_t ssr_energy_wh(uint8_t ch, uint32_t cycles);    // convert on-cycles to watt-hours
 
 // temporarily here
 void fan_setup(void);
@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ovencon.h"
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "oven_stats.h"
+
+
+static s_stat stats[STAT_SECTIONS];
+
+volatile uint8_t stats_asleep;
+
+// load window; halved whenever elapsed passes LOAD_WINDOW so that
+// busy*1000 never overflows and old history decays away
+#define LOAD_WINDOW     (1UL << 21)     // ~17s at 8MHz
+
+static uint32_t load_busy[LOAD_TASKS];
+static uint32_t load_busy_total;
+static uint32_t load_elapsed;
+static uint16_t load_last;
+
+void stats_reset(void)
+{
+    uint8_t i, intr_state = SREG;
+
+    cli();
+    memset(stats,0,sizeof(stats));
+    for(i=0;i<STAT_SECTIONS;i++)
+        stats[i].min = 0xFFFF;
+    memset(load_busy,0,sizeof(load_busy));
+    load_elapsed = 0;
+    SREG = intr_state;
+}
+
+void stats_setup(void)
+{
+    stats_reset();
+
+    // Timer3 free-running (normal mode), clk/64: 8us ticks at 8MHz, wraps after ~0.5s
+    TCCR3A  = 0;
+    TCCR3B  = _BV(CS31) | _BV(CS30);
+    TIMSK3  = 0;
+
+    load_busy_total = 0;
+    load_last = 0;
+    stats_asleep = 0;
+}
+
+uint16_t stats_now(void)
+{
+    uint16_t t;
+    uint8_t intr_state = SREG;
+
+    // 16-bit reads share the timer's TEMP register with any ISR reading it
+    cli();
+    t = TCNT3;
+    SREG = intr_state;
+
+    return t;
+}
+
+void stats_record(uint8_t section, uint16_t ticks)
+{
+    s_stat *s = &stats[section];
+    uint8_t bucket = 0;
+    uint16_t v = ticks >> 1;
+    uint8_t intr_state;
+
+    while(v && bucket < STAT_BUCKETS-1) {
+        v >>= 1;
+        bucket++;
+    }
+
+    intr_state = SREG;
+    cli();
+
+    s->count++;
+    if(ticks < s->min) s->min = ticks;
+    if(ticks > s->max) s->max = ticks;
+    if(s->hist[bucket] != 0xFFFF) s->hist[bucket]++;
+
+    SREG = intr_state;
+}
+
+void stats_get(uint8_t section, s_stat *stat)
+{
+    uint8_t intr_state = SREG;
+
+    cli();
+    *stat = stats[section];
+    SREG = intr_state;
+}
+
+void load_begin(s_load_mark *mark)
+{
+    uint8_t intr_state = SREG;
+
+    cli();
+    mark->start = TCNT3;
+    mark->busy  = load_busy_total;
+    SREG = intr_state;
+}
+
+uint16_t load_end(uint8_t task, s_load_mark *mark)
+{
+    uint16_t dur, nested;
+    uint8_t intr_state = SREG;
+
+    cli();
+    dur     = TCNT3 - mark->start;
+    nested  = load_busy_total - mark->busy;
+
+    // time spent in measured tasks that interrupted this one is theirs
+    if(nested < dur) {
+        load_busy[task] += dur - nested;
+        load_busy_total += dur - nested;
+    }
+    SREG = intr_state;
+
+    return dur;
+}
+
+void load_tick(void)
+{
+    uint8_t i, intr_state = SREG;
+    uint16_t now;
+
+    cli();
+    now = TCNT3;
+    load_elapsed += (uint16_t)(now - load_last);
+    load_last = now;
+
+    if(load_elapsed >= LOAD_WINDOW) {
+        load_elapsed >>= 1;
+        for(i=0;i<LOAD_TASKS;i++)
+            load_busy[i] >>= 1;
+    }
+    SREG = intr_state;
+}
+
+void load_get(uint16_t *permille, uint16_t *idle)
+{
+    uint32_t busy[LOAD_TASKS];
+    uint32_t elapsed, total = 0;
+    uint8_t i, intr_state = SREG;
+
+    cli();
+    memcpy(busy,load_busy,sizeof(busy));
+    elapsed = load_elapsed;
+    SREG = intr_state;
+
+    for(i=0;i<LOAD_TASKS;i++) {
+        permille[i] = elapsed ? (busy[i] * 1000) / elapsed : 0;
+        total += permille[i];
+    }
+
+    *idle = (total < 1000) ? 1000 - total : 0;
+}
+
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef OVEN_STATS_H_INCLUDED
+#define OVEN_STATS_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// profiled sections
+#define STAT_TIMER_LATENCY  0   // compare match to timer ISR entry (TCNT1 ticks)
+#define STAT_SSR            1   // oven_update_120hz()
+#define STAT_CONTROL        2   // oven_update_4hz()
+#define STAT_LCD            3   // lcd_update()
+#define STAT_MESSAGE        4   // process_message()
+#define STAT_WAKE_LATENCY   5   // compare match to timer ISR entry, woken from idle sleep (TCNT1 ticks)
+#define STAT_SECTIONS       6
+
+// log2 histogram: bucket n counts samples of 2^n..2^(n+1)-1 ticks (last bucket is open-ended)
+#define STAT_BUCKETS        8
+
+typedef struct
+{
+    uint32_t    count;
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    hist[STAT_BUCKETS]; // saturating
+} s_stat;
+
+// set by the main loop just before sleeping; cleared by whoever wakes first
+extern volatile uint8_t stats_asleep;
+
+void stats_setup(void);
+void stats_reset(void);
+
+// free-running timestamp (Timer3, clk/64)
+uint16_t stats_now(void);
+
+// record a sample (ticks) against a section; safe from any context
+void stats_record(uint8_t section, uint16_t ticks);
+
+void stats_get(uint8_t section, s_stat *stat);
+
+
+// CPU load accounting.  Each task's exclusive time (minus any measured task
+// that interrupted it) is accumulated; idle is whatever is left over.
+#define LOAD_CONTROL        0
+#define LOAD_SSR            1
+#define LOAD_USB_RX         2
+#define LOAD_USB_TX         3
+#define LOAD_LCD            4
+#define LOAD_THERMISTOR     5
+#define LOAD_TASKS          6
+
+typedef struct
+{
+    uint16_t    start;
+    uint32_t    busy;       // total busy time when the task started
+} s_load_mark;
+
+void load_begin(s_load_mark *mark);
+uint16_t load_end(uint8_t task, s_load_mark *mark); // returns the inclusive duration (ticks)
+
+// advance the load window's elapsed time; call at least every ~0.5s (Timer3 wrap)
+void load_tick(void);
+
+// per-task load and idle, in tenths of a percent
+void load_get(uint16_t *permille, uint16_t *idle);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
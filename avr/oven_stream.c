@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_stream.h"
+
+
+typedef struct
+{
+    uint16_t    time;
+    int16_t     target;
+} s_stream_point;
+
+static s_stream_point stream_buf[STREAM_POINTS];
+static uint8_t  stream_head;        // oldest point
+static uint8_t  stream_len;
+static uint16_t stream_under;
+static uint8_t  stream_dry;         // ran past the last point
+
+#define AT(n) stream_buf[(uint8_t)(stream_head + (n)) % STREAM_POINTS]
+
+void stream_clear(void)
+{
+    stream_head     = 0;
+    stream_len      = 0;
+    stream_under    = 0;
+    stream_dry      = 0;
+}
+
+uint8_t stream_push(uint16_t time, int16_t target)
+{
+    s_stream_point *p;
+
+    if(stream_len >= STREAM_POINTS)
+        return 0;
+
+    // times wrap with the status line's; compare differences
+    if(stream_len && (int16_t)(time - AT(stream_len-1).time) <= 0)
+        return 0;
+
+    p = &AT(stream_len);
+    p->time     = time;
+    p->target   = target;
+    stream_len++;
+    stream_dry  = 0;
+
+    return 1;
+}
+
+int16_t stream_update(uint16_t now, int16_t current)
+{
+    s_stream_point *a, *b;
+    int16_t span, into;
+
+    if(!stream_len || (int16_t)(now - AT(0).time) < 0)
+        return current;
+
+    // drop points that the next one has superseded
+    while(stream_len >= 2 && (int16_t)(now - AT(1).time) >= 0)
+    {
+        stream_head = (stream_head + 1) % STREAM_POINTS;
+        stream_len--;
+    }
+
+    a = &AT(0);
+    if(stream_len < 2)
+    {
+        // past the end: hold, and note the host fell behind (once)
+        if(now != a->time && !stream_dry) {
+            stream_dry = 1;
+            stream_under++;
+        }
+        return a->target;
+    }
+
+    b       = &AT(1);
+    span    = b->time - a->time;
+    into    = now - a->time;
+
+    return a->target + (int16_t)((((int32_t)b->target - a->target) * into) / span);
+}
+
+uint8_t stream_count(void)
+{
+    return stream_len;
+}
+
+uint16_t stream_underruns(void)
+{
+    return stream_under;
+}
+
@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_STREAM_H_INCLUDED
+#define OVEN_STREAM_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Streamed setpoints: the host queues (time, target) points ahead of time,
+// in status-line time units (control ticks) and 0.25C.  Each control tick
+// interpolates between the points either side of the current time, so the
+// trajectory doesn't depend on when the points arrived.
+
+#define STREAM_POINTS   16  // 4s deep at one point per tick, longer if sparser
+
+void stream_clear(void);
+
+// queue a point; times must increase.  Returns 0 if it was refused (full,
+// or not after the last point)
+uint8_t stream_push(uint16_t time, int16_t target);
+
+// target for control tick now; holds the current target before the first
+// point, and the last point's target (counting an underrun) after it
+int16_t stream_update(uint16_t now, int16_t current);
+
+uint8_t stream_count(void);
+uint16_t stream_underruns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "oven_telem.h"
+
+
+static uint16_t telem_mask;
+static uint8_t  telem_min;
+static uint8_t  telem_max;
+static uint8_t  telem_ticks;                    // since the last line
+static uint16_t telem_band[TELEM_FIELDS];
+static int32_t  telem_last[TELEM_FIELDS];       // as last sent
+
+void telem_reset(void)
+{
+    uint8_t i;
+
+    telem_config(TELEM_ALL,1,1);
+    for(i=0;i<TELEM_FIELDS;i++)
+        telem_band[i] = 0;
+}
+
+void telem_config(uint16_t mask, uint8_t min_ticks, uint8_t max_ticks)
+{
+    if(min_ticks < 1)           min_ticks = 1;
+    if(max_ticks < min_ticks)   max_ticks = min_ticks;
+
+    telem_mask  = mask & TELEM_ALL;
+    telem_min   = min_ticks;
+    telem_max   = max_ticks;
+    telem_ticks = max_ticks; // next tick sends
+}
+
+void telem_deadband(uint8_t field, uint16_t band)
+{
+    if(field < TELEM_FIELDS)
+        telem_band[field] = band;
+}
+
+void telem_get(uint16_t *mask, uint8_t *min_ticks, uint8_t *max_ticks)
+{
+    *mask       = telem_mask;
+    *min_ticks  = telem_min;
+    *max_ticks  = telem_max;
+}
+
+uint16_t telem_get_deadband(uint8_t field)
+{
+    return field < TELEM_FIELDS ? telem_band[field] : 0;
+}
+
+void telem_tick(void)
+{
+    if(telem_ticks != 255)
+        telem_ticks++;
+}
+
+uint8_t telem_due(const int32_t *values)
+{
+    uint8_t i;
+    int32_t d;
+
+    if(telem_ticks < telem_min)
+        return 0;
+    if(telem_ticks >= telem_max)
+        return 1;
+
+    for(i=0;i<TELEM_FIELDS;i++)
+    {
+        if(!(telem_mask & (1 << i)))
+            continue;
+
+        d = values[i] - telem_last[i];
+        if(d < 0) d = -d;
+        if(d > telem_band[i])
+            return 1;
+    }
+
+    return 0;
+}
+
+void telem_sent(const int32_t *values)
+{
+    uint8_t i;
+
+    for(i=0;i<TELEM_FIELDS;i++)
+        telem_last[i] = values[i];
+    telem_ticks = 0;
+}
+
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2012, Lawrence Leung
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *   - Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   - The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef OVEN_TELEM_H_INCLUDED
+#define OVEN_TELEM_H_INCLUDED
+
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#include <stdint.h>
+
+// Event-driven status telemetry.  The status line keeps its full layout;
+// subscribed fields (bit n = nth field of the line) trigger it when they
+// move by more than their deadband, no more often than every min_ticks
+// control ticks, and it is always sent after max_ticks (heartbeat).
+// Defaults (all fields, no deadband, 1/1 tick) send every tick.
+
+#define TELEM_FIELDS    12
+#define TELEM_ALL       ((1 << TELEM_FIELDS) - 1)
+
+void telem_reset(void);
+
+// min_ticks >= 1; max_ticks is raised to min_ticks if below it
+void telem_config(uint16_t mask, uint8_t min_ticks, uint8_t max_ticks);
+
+void telem_deadband(uint8_t field, uint16_t band);
+
+void telem_get(uint16_t *mask, uint8_t *min_ticks, uint8_t *max_ticks);
+uint16_t telem_get_deadband(uint8_t field);
+
+// once per control tick, whether or not a line can go out
+void telem_tick(void);
+
+// with the current field values, when a line could be queued: should it be?
+uint8_t telem_due(const int32_t *values);
+
+// a line with these values was queued
+void telem_sent(const int32_t *values);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
+
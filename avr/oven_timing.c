@@ -30,13 +30,67 @@
 #include <stdint.h>
 
 #include "oven_timing.h"
+#include "oven_ssr.h"
+#include "oven_stats.h"
+#include "oven_pll.h"
+
+#if (F_CPU!=16000000) && (F_CPU!=8000000)
+#error "FCPU not 16mhz or 8mhz"
+#endif
 
 
 volatile static uint8_t div;
+volatile static uint8_t in_control; // oven_update_4hz() is running
+
+// derived from the mains configuration by timing_configure()
+static uint8_t  mains_hz;
+static uint8_t  ssr_window;
+static uint16_t timer_top;      // ICR1 for one mains half-cycle (the timer counts TOP+1 clk/8 ticks)
+static uint8_t  timer_div;      // half-cycles per control tick (4 Hz)
+static uint8_t  timer_speed;    // control ticks per 4 Hz tick (replay only), divides timer_div
+static uint8_t  tick_div;       // half-cycles per control tick at that speed
+
+// the SSR update fires this fraction of a half-cycle ahead of the zero-cross
+#define TIMER_COMPARE(top)  ((top) - ((top) / 6))
+
+#ifdef ZERO_CROSS_SYNC
+static s_pll pll;
+#endif
+
+// largest divisor of timer_div no greater than speed, so the control tick
+// runs exactly timer_speed times faster (at 60 Hz: 1, 2, 3, 5 or 6)
+static void _timing_speed(uint8_t speed)
+{
+    while(timer_div % speed)
+        speed--;
+
+    timer_speed = speed;
+    tick_div    = timer_div / speed;
+}
+
+static void _timing_derive(uint8_t hz, uint8_t window)
+{
+    mains_hz    = hz;
+    timer_top   = (uint16_t)((F_CPU / 16) / hz) - 1;   // F_CPU/8 ticks per second, two half-cycles per period
+    timer_div   = hz >> 1;                          // 2*hz half-cycles per second / 4 Hz
+
+    // default modulation window is one control tick
+    ssr_window  = window ? window : timer_div;
+    ssr_set_window(ssr_window);
+
+    _timing_speed(timer_speed);
+    div         = 0;
+
+#ifdef ZERO_CROSS_SYNC
+    pll_reset(&pll,timer_top);
+#endif
+}
 
 void timing_setup(void)
 {
-    div     = 0;
+    in_control = 0;
+    timer_speed = 1;
+    _timing_derive(DEFAULT_MAINS_HZ, DEFAULT_SSR_WINDOW);
 
     cli(); // turn off interrupts temporarily
 
@@ -50,28 +104,23 @@ void timing_setup(void)
     TCCR1B  = _BV(WGM13) | _BV(WGM12) |  _BV(CS11); // CTC, clk div 8
     TCCR1C  = 0;
 
-    // 119.998 Hz (no external sync)
-#if (F_CPU==16000000)
-    ICR1    = 16667; 
-    OCR1A   = 14000; 
-#elif (F_CPU==8000000)
-    ICR1    = 8404; 
-    OCR1A   = 7000;
-#else
-#error "FCPU not 16mhz or 8mhz"
-#endif
+    // twice mains frequency (trimmed by the zero-cross PLL when ZERO_CROSS_SYNC is enabled)
+    ICR1    = timer_top;
+    OCR1A   = TIMER_COMPARE(timer_top);
 
 
     TIMSK1  = _BV(OCIE1A); // enable OCRA1 interrupt
 
 
-    // enable external interrupt (INT0/PD0 and INT1/PD1; falling edge)
-    // TODO: not currently used; requires extra hardware to sample mains
-    // (e.g. a low-voltage transformer)
-//    DDRD    &= ~(_BV(0) | _BV(1));
-//    PORTD   |= _BV(0) | _BV(1); // pull-up
-//    EICRA   = _BV(ISC01) | _BV(ISC11);
-//    EIMSK   = _BV(INT0) | _BV(INT1);
+#ifdef ZERO_CROSS_SYNC
+    // enable external interrupt (INT0/PD0; falling edge, one edge per half-cycle)
+    // requires extra hardware to sample mains (e.g. an AC-input optocoupler)
+    DDRD    &= ~(_BV(0));
+    PORTD   |= _BV(0); // pull-up
+    EICRA   = _BV(ISC01);
+    EIFR    = _BV(INTF0);
+    EIMSK   = _BV(INT0);
+#endif
 
 
     // E6 blinky
@@ -84,23 +133,161 @@ void timing_setup(void)
 // timer interrupt
 ISR(TIMER1_COMPA_vect)
 {
+    s_load_mark mark;
+
+    stats_record(stats_asleep ? STAT_WAKE_LATENCY : STAT_TIMER_LATENCY, TCNT1 - OCR1A);
+    stats_asleep = 0;
+    load_tick();
+
+#ifdef ZERO_CROSS_SYNC
+    // TCNT1 has just passed OCR1A, which is well below any period the PLL can
+    // pick, so the new TOP can be written here without missing the wrap
+    ICR1 = pll.period;
+
+    // lost the mains signal; fall back to free-running
+    if(pll_period_elapsed(&pll))
+        ICR1 = timer_top;
+#endif
+
+    load_begin(&mark);
     oven_update_120hz();
+    stats_record(STAT_SSR, load_end(LOAD_SSR, &mark));
     div++;
 
     // re-enable interrupts
     sei();
 
-    // execute control update every 30 steps (120/30 = 4 Hz)
-    if (30==div)
+    // execute control update every timer_div steps (e.g. 120/30 = 4 Hz),
+    // or every tick_div steps when replaying faster than real time
+
+    // never re-enter a control update that has overrun; the SSR watchdog
+    // shuts the outputs off if it doesn't come back
+    if (div >= tick_div && !in_control)
     {
         div = 0;
+        in_control = 1;
+        load_begin(&mark);
         oven_update_4hz();
+        stats_record(STAT_CONTROL, load_end(LOAD_CONTROL, &mark));
+        in_control = 0;
     	PORTE ^=_BV(6); //blink E6
     }
 }
 
-// AC zero-cross interrupts - just clear timer
-//ISR(INT0_vect) { TCNT1 = 0; }
-//ISR(INT1_vect) { TCNT1 = 0; }
+#ifdef ZERO_CROSS_SYNC
+
+// AC zero-cross interrupt - steer the timer period so that the timer wraps on
+// the zero-cross (and the SSR update at OCR1A lands just ahead of it)
+ISR(INT0_vect)
+{
+    pll_edge(&pll,TCNT1,ICR1);
+}
+
+#endif
+
+void timing_configure(uint8_t hz, uint8_t window)
+{
+    uint8_t intr_state;
+
+    if(hz != 50 && hz != 60)
+        return;
+
+    intr_state = SREG;
+    cli();
+
+    _timing_derive(hz, window);
+
+    ICR1    = timer_top;
+    OCR1A   = TIMER_COMPARE(timer_top);
+    if(TCNT1 > timer_top)
+        TCNT1 = 0;
+
+    SREG = intr_state;
+}
+
+uint16_t timing_ssr_deadline(void)
+{
+    // the timer wraps (at the zero-cross) one tick after reaching TOP
+    return timer_top + 1 - TIMER_COMPARE(timer_top);
+}
+
+uint32_t timing_since_tick_us(void)
+{
+    uint8_t intr_state = SREG, d;
+    uint16_t t, top, cmp;
+    uint32_t elapsed;
+
+    cli();
+    t   = TCNT1;
+    top = ICR1;
+    cmp = OCR1A;
+    d   = div;
+    // a compare match before TCNT1 was read whose interrupt hasn't run yet
+    if((TIFR1 & _BV(OCF1A)) && t >= cmp)
+        d++;
+    SREG = intr_state;
+
+    // Timer1 ticks since the last compare match, plus a period per
+    // half-cycle since the one that ran the control tick
+    elapsed  = (t >= cmp) ? t - cmp : (uint32_t)t + top + 1 - cmp;
+    elapsed += (uint32_t)d * (top + 1);
+
+    // clk/8
+    return elapsed * 8 / (F_CPU / 1000000UL);
+}
+
+void timing_set_speed(uint8_t speed)
+{
+    uint8_t intr_state = SREG;
+
+    if(speed < 1)
+        speed = 1;
+    if(speed > TIMING_MAX_SPEED)
+        speed = TIMING_MAX_SPEED;
+
+    cli();
+    _timing_speed(speed);
+    SREG = intr_state;
+}
+
+uint8_t timing_speed(void)
+{
+    return timer_speed;
+}
+
+uint8_t timing_mains_hz(void)
+{
+    return mains_hz;
+}
+
+uint8_t timing_ssr_window(void)
+{
+    return ssr_window;
+}
+
+uint8_t timing_locked(void)
+{
+#ifdef ZERO_CROSS_SYNC
+    return pll.locked;
+#else
+    return 0;
+#endif
+}
+
+int16_t timing_phase_error(void)
+{
+#ifdef ZERO_CROSS_SYNC
+    int16_t err;
+    uint8_t intr_state = SREG;
+
+    cli();
+    err = pll.phase_err;
+    SREG = intr_state;
+
+    return err;
+#else
+    return 0;
+#endif
+}
 
 
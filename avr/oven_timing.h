@@ -32,8 +32,36 @@
 #ifdef __cplusplus
 extern "C"{
 #endif
+
+#include <stdint.h>
+
 void timing_setup(void);
 
+// select mains frequency (50 or 60 Hz) and SSR modulation window (half-cycles;
+// 0 for one control tick).  Timer period, SSR window and the 4 Hz control
+// divider are all derived from these.
+void timing_configure(uint8_t hz, uint8_t window);
+uint8_t timing_mains_hz(void);
+uint8_t timing_ssr_window(void);
+
+// run control ticks speed times faster than 4 Hz (1 to TIMING_MAX_SPEED),
+// for replaying logs through fake_in/fake_out; the SSR keeps mains timing.
+// speed is rounded down to a divisor of the half-cycles per control tick,
+// and timing_speed() returns the speed-up actually in effect
+#define TIMING_MAX_SPEED    8
+void timing_set_speed(uint8_t speed);
+uint8_t timing_speed(void);
+
+// Timer1 ticks from the SSR update to the zero-cross it has to make
+uint16_t timing_ssr_deadline(void);
+
+// time since the last control tick started, in microseconds
+uint32_t timing_since_tick_us(void);
+
+// zero-cross PLL status (always unlocked/0 without ZERO_CROSS_SYNC)
+uint8_t timing_locked(void);
+int16_t timing_phase_error(void); // timer ticks; positive when the timer wraps ahead of the zero-cross
+
 
 
 #ifdef __cplusplus
@@ -26,10 +26,13 @@
 
 #include "ovencon.h"
 #include <util/delay.h>
+#include <avr/wdt.h>
+#include <avr/sleep.h>
 #include <stdint.h>
 
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 
 #include "usb_serial.h"
 
@@ -38,8 +41,16 @@
 #include "oven_pid.h"
 #include "oven_profile.h"
 #include "oven_lcd.h"
+#include "oven_stats.h"
+#include "oven_fusion.h"
+#include "oven_monitor.h"
+#include "oven_fault.h"
+#include "oven_cal.h"
+#include "oven_fmt.h"
+#include "oven_telem.h"
+#include "oven_stream.h"
+#include "oven_mem.h"
 #include "max6675.h"
-#include "arduino/PCD8544.h"
 #include "thermistor.h"
 
 
@@ -48,6 +59,7 @@
 volatile uint8_t mode_fake_out;
 volatile uint8_t mode_fake_in;
 volatile uint8_t mode_manual;
+volatile uint8_t mode_stream;       // idle target follows streamed setpoints
 
 // TODO: there is a risk that some of these 16-bit values could be caught
 // in a half-updated state, if the timer interrupt causes oven_update_4hz
@@ -73,6 +85,31 @@ extern volatile uint8_t k_d;
 #define CMD_PAUSE   3
 #define CMD_RESUME  4
 
+// setters recognised by process_message, applied with interrupts disabled
+#define SET_NONE        0
+#define SET_TEMP        1
+#define SET_CMD         2
+#define SET_TARGET      3
+#define SET_FAKE_OUT    4
+#define SET_FAKE_IN     5
+#define SET_MANUAL      6
+#define SET_PID         7
+#define SET_MAINS       8
+#define SET_PEAK_LIMIT  9
+#define SET_FILTER      10
+#define SET_WATTS       11
+#define SET_SP          12
+#define SET_STREAM      13
+#define SET_SPEED       14
+#define SET_PING        15
+#define SET_TELEMETRY   16
+#define SET_DEADBAND    17
+#define SET_MONITOR     18
+#define SET_RESET       19
+#define SET_GO          20
+#define SET_PAUSE       21
+#define SET_RESUME      22
+
 // TODO: currently, only one comm_cmd can be processed per oven_update_4hz
 // invocation, so multiple commands received within a ~0.25s window may be lost
 volatile uint8_t comm_cmd;
@@ -96,53 +133,142 @@ volatile uint16_t time;
 volatile uint8_t fan_pwm;
 
 volatile int16_t temp_t,temp_b; // last read temps
+volatile int16_t temp_fine;      // top temp in 1/16C, for the pid
 
 volatile uint8_t should_update_lcd;
 
+// "ping": host timestamp, and the device time it arrived (status line time
+// of the last tick, plus microseconds since that tick started)
+uint32_t ping_host, ping_rx_us;
+uint16_t ping_rx_time;
+volatile uint8_t ping_pending;
+
+// energy metering: on-cycle counts at the start of the current run
+uint32_t run_cycles_t, run_cycles_b;
+volatile uint8_t run_energy_pending;
+
 
+// outgoing queue: whole lines are appended (from anywhere) at tx_len; the
+// main loop sends from tx_pos and empties it once everything has gone
 char tx_msg[255];
 volatile uint8_t tx_len = 0;
+uint8_t tx_pos;
 
 uint8_t is_usb_ready(){
     return usb_configured() & (usb_serial_get_control() & USB_SERIAL_DTR);
 }
 
+// append to the outgoing queue, all or nothing; never waits on the host, so
+// it's safe from the timer interrupt.  Returns 0 if there wasn't room
+uint8_t tx_queue(const char *msg, uint8_t len)
+{
+    uint8_t ok = 0, intr_state = SREG;
+
+    cli();
+    if(len <= sizeof(tx_msg) - tx_len) {
+        memcpy(tx_msg + tx_len,msg,len);
+        tx_len += len;
+        ok = 1;
+    }
+    SREG = intr_state;
+
+    return ok;
+}
+
+uint8_t tx_queue_P(PGM_P fmt, ...)
+{
+    char buf[56]; // longest is a pong with every field at its widest (52)
+    va_list ap;
+    int len;
+
+    va_start(ap,fmt);
+    len = vsnprintf_P(buf,sizeof(buf),fmt,ap);
+    va_end(ap);
+
+    // a cut-off line would lose its new-line and run into the next one
+    if (len <= 0 || len >= (int)sizeof(buf)) return 0;
+    return tx_queue(buf,len);
+}
+
+// send what's queued; main loop only.  Without wait, only what the USB
+// packet has room for right now; returns the number of bytes sent
+uint8_t tx_send(uint8_t wait)
+{
+    uint8_t len = tx_len, sent = 0, intr_state;
+
+    if(tx_pos < len)
+    {
+        if(wait) {
+            // blocks (up to the usb_serial timeout) if the host isn't reading
+            usb_serial_write((const uint8_t*)tx_msg + tx_pos,len - tx_pos);
+            sent = len - tx_pos;
+        } else {
+            sent = usb_serial_write_nowait((const uint8_t*)tx_msg + tx_pos,len - tx_pos);
+        }
+        tx_pos += sent;
+    }
+
+    // empty: the control loop can generate a new message
+    intr_state = SREG;
+    cli();
+    if(tx_pos == tx_len)
+        tx_len = tx_pos = 0;
+    SREG = intr_state;
+
+    return sent;
+}
+
 
+// shut down: outputs latched off until "reset"
 void fault(void)
 {
-// TODO: need to mask faults briefly at power-up, otherwise this will
-// prematurely trip due to bogus thermocouple data
-//    state = ST_FAULT;
-//    ssr_fault();
+    state = ST_FAULT;
+    ssr_fault();
 
-    tx_len=sprintf_P(tx_msg,PSTR("FAULT\n"));
-    if (!is_usb_ready()) return;
-    usb_serial_write((const uint8_t*)tx_msg,tx_len);
-    tx_len = 0; // clear the length, so the control loop knows it can generate a new message
+    tx_queue_P(PSTR("FAULT\n"));
 }
 
 void thermocouple_fault(int16_t result)
 {
-    tx_len = sprintf_P(tx_msg,PSTR("TFAULT: %d\n"),
+    tx_queue_P(PSTR("TFAULT: %d\n"),
 	            result);
+}
+
+void monitor_fault(uint8_t code)
+{
+    tx_queue_P(PSTR("MFAULT: %u,%d,%d\n"),
+                code, monitor_slope(), monitor_expected());
+}
+
+// formatted reply to a host query; main loop only (may block on the host)
+void reply_P(PGM_P fmt, ...)
+{
+    char buf[128]; // caps with every option enabled is ~120
+    va_list ap;
+    int len;
+
     if (!is_usb_ready()) return;
-     usb_serial_write((const uint8_t*)tx_msg,tx_len);
-     tx_len = 0; // clear the length, so the control loop knows it can generate a new message
+
+    va_start(ap,fmt);
+    len = vsnprintf_P(buf,sizeof(buf),fmt,ap);
+    va_end(ap);
+
+    // don't cut into a half-sent status line
+    tx_send(1);
+
+    // keep the host's lines in step even if this one is cut short
+    if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf)-1;
+        buf[len-1] = '\n';
+    }
+    if (len > 0)
+        usb_serial_write((const uint8_t*)buf,len);
 }
 
 void debugmsg(PGM_P  pmsg){
 #ifdef DEBUG
-    if (!is_usb_ready()) return;
-    
-    if (tx_len>0)
-        usb_serial_write((void*)tx_msg,tx_len);
-    tx_len = sprintf_P(tx_msg,pmsg);
-    usb_serial_write((void*)tx_msg,tx_len);
+    tx_queue_P(pmsg);
 #endif
-    //tx_msg[0]=0;
-   // tx_len = 0; // clear the length, so the control loop knows it can generate a new message
-   //  _delay_ms(100);
-
 }
 
 void oven_output(uint8_t top, uint8_t bot)
@@ -164,24 +290,52 @@ void oven_input(volatile int16_t *top,volatile int16_t *bot)
       
 #ifdef USE_THERMOCOUPLE
         
-    	*top = max6675_read(0);
+        int16_t tc;
+        uint8_t bad;
+
+        // fault values never reach the pid: the last good reading is held
+        tc  = max6675_read(0);
+        bad = (tc == MAX6675_OPEN || tc == MAX6675_RANGE);
+    	*top = fault_sensor(FAULT_TOP,tc,bad);
+        temp_fine = bad ? *top << 2 : max6675_read_fine(0);
+
+#ifdef SENSOR_FUSION
+        // fuse with the thermistor at the control rate; faulted thermocouple
+        // reads just leave the tracker coasting
+        fusion_update(bad ? -1 : tc, thermistor_read());
+        *top = fusion_temp();
+#endif
 
 #ifndef BOTTOM_THERM
     	*bot = *top;
 #else
-        *bot = max6675_read(1);
+        tc  = max6675_read(1);
+        bad = (tc == MAX6675_OPEN || tc == MAX6675_RANGE);
+        *bot = fault_sensor(FAULT_BOT,tc,bad);
 #endif
         
 #endif  
         
 // thermistor reads from the main loop for now since the ADC read is a bit slow
+// (except when fused with the thermocouple, above)
         
         
     }
     else
     {
+        int16_t fake = fake_temp_t;
+
         *top = fake_temp_t;
         *bot = fake_temp_b;
+
+        // the host can send anything: past +/-2048C the 1/16C value
+        // saturates instead of overflowing
+        if(fake > INT16_MAX/4)
+            temp_fine = INT16_MAX;
+        else if(fake < INT16_MIN/4)
+            temp_fine = INT16_MIN;
+        else
+            temp_fine = fake * 4;
     }
 }
 
@@ -201,6 +355,7 @@ void oven_setup(void)
     mode_fake_out   = 0;
     mode_fake_in    = 0;
     mode_manual     = 0;
+    mode_stream     = 0;
 
     manual_cmd_t    = 0;
     manual_cmd_b    = 0;
@@ -209,6 +364,7 @@ void oven_setup(void)
     fake_temp_b     = 0;
     temp_t =0;
     temp_b =0;
+    temp_fine =0;
 
     k_p   = DEFAULT_K_P;
     k_i   = DEFAULT_K_I;
@@ -219,13 +375,22 @@ void oven_setup(void)
     target          = 0;
     time            = 0;
     tx_len          = 0;
+    tx_pos          = 0;
     should_update_lcd=0;
+    run_energy_pending = 0;
+    ping_pending    = 0;
 
     ssr_setup();
     fan_setup();
     lcd_init();
     pid_reset();
     profile_reset();
+    stats_setup();
+    fusion_reset(100); // room temp
+    monitor_setup();
+    fault_reset();
+    telem_reset();
+    stream_clear();
 
     
 #ifdef USE_THERMOCOUPLE
@@ -241,9 +406,69 @@ void oven_setup(void)
     timing_setup();
 }
 
+// one status line's fields
+typedef struct
+{
+    uint8_t     state;
+    uint16_t    time;
+    int16_t     target;
+    int16_t     temp_t;
+    int16_t     temp_b;
+    uint8_t     cmd;
+    uint8_t     cmd_t;
+    uint8_t     cmd_b;
+    uint8_t     locked;
+    int16_t     phase_err;
+    uint32_t    wh_t;
+    uint32_t    wh_b;
+} s_status;
+
+// "%s,%u,%d,%d,%d,%u,%u,%u,%u,%d,%lu,%lu\n" without printf; returns the length
+uint8_t status_format(char *buf, const s_status *st)
+{
+    char *p = buf;
+
+    p = fmt_str(p,state_names[st->state]);  *p++ = ',';
+    p = fmt_u16(p,st->time);                *p++ = ',';
+    p = fmt_i16(p,st->target);              *p++ = ',';
+    p = fmt_i16(p,st->temp_t);              *p++ = ',';
+    p = fmt_i16(p,st->temp_b);              *p++ = ',';
+    p = fmt_u16(p,st->cmd);                 *p++ = ',';
+    p = fmt_u16(p,st->cmd_t);               *p++ = ',';
+    p = fmt_u16(p,st->cmd_b);               *p++ = ',';
+    p = fmt_u16(p,st->locked);              *p++ = ',';
+    p = fmt_i16(p,st->phase_err);           *p++ = ',';
+    p = fmt_u32(p,st->wh_t);                *p++ = ',';
+    p = fmt_u32(p,st->wh_b);                *p++ = '\n';
+
+    return p - buf;
+}
+
+// the printf version status_format() replaced (kept for "fmt_bench")
+uint8_t status_format_P(char *buf, const s_status *st)
+{
+    return sprintf_P(buf,PSTR("%s,%u,%d,%d,%d,%u,%u,%u,%u,%d,%lu,%lu\n"),
+        state_names[st->state],
+        st->time,
+        st->target,
+        st->temp_t,
+        st->temp_b,
+        st->cmd,
+        st->cmd_t,
+        st->cmd_b,
+        st->locked,
+        st->phase_err,
+        st->wh_t,
+        st->wh_b);
+}
+
 void oven_update_120hz(void)
 {
     ssr_update();
+
+#ifdef USE_THERMOCOUPLE
+    max6675_poll();
+#endif
 }
 
 
@@ -251,6 +476,7 @@ void oven_update_4hz(void)
 {
     uint8_t cmd,cmd_t,cmd_b;
    
+    fault_tick();
     oven_input(&temp_t,&temp_b);
 
     if(comm_cmd != 0)
@@ -264,10 +490,15 @@ void oven_update_4hz(void)
                 manual_cmd_t    = 0;
                 manual_cmd_b    = 0;
                 state           = ST_IDLE;
+                ssr_clear_fault();
+                monitor_reset();
+                fault_reset();
                 break;
             case CMD_GO:
                 if(state == ST_IDLE) {
                     state           = ST_RUN;
+                    run_cycles_t    = ssr_get_on_cycles(SSR_TOP);
+                    run_cycles_b    = ssr_get_on_cycles(SSR_BOT);
                 }
                 break;
             case CMD_PAUSE:
@@ -287,14 +518,41 @@ void oven_update_4hz(void)
         comm_cmd = 0;
     }
 
+    // answer a ping from the control tick, like any other command, with
+    // when it arrived and when it was acted on
+    if(ping_pending)
+    {
+        if(tx_queue_P(PSTR("pong: %lu,%u,%lu,%u,%lu\n"),
+                ping_host,
+                ping_rx_time,
+                ping_rx_us,
+                time,
+                timing_since_tick_us()))
+            ping_pending = 0;
+    }
+
+    // the SSR watchdog latched the outputs off while this tick was stalled,
+    // or a sensor has been failing
+    if((ssr_watchdog_tripped() || fault_tripped()) && state != ST_FAULT)
+    {
+        fault();
+    }
+
     switch(state)
     {
+        case ST_FAULT:
+            target = 0;
+            break;
         case ST_IDLE:
             target = manual_target;
+            if(mode_stream)
+                target = stream_update(time,target);
             break;
         case ST_RUN:
-            if(profile_update(&target))
+            if(profile_update(&target)) {
                 state = ST_DONE;
+                run_energy_pending = 1;
+            }
             break;
         case ST_PAUSE:
             // hold target
@@ -310,7 +568,18 @@ void oven_update_4hz(void)
     // when enabling manual mode)
     manual_target = target;
     
+#ifdef SENSOR_FUSION
+    // the fused rate estimate replaces the least-squares derivative
+    if( !mode_fake_in )
+        cmd = pid_update_d(temp_t,target,
+                -(int16_t)(((int32_t)fusion_rate() * PID_DERIVATIVE_STEPS) >> 8));
+    else
+#endif
+#ifdef USE_THERMOCOUPLE
+    cmd = pid_update_fine(temp_fine,target);
+#else
     cmd = pid_update(temp_t,target);
+#endif
 
     if( state == ST_IDLE && mode_manual )
     {
@@ -345,29 +614,228 @@ void oven_update_4hz(void)
     oven_output(cmd_t,cmd_b);
     fan_update(fan_pwm);
 
+    // faster than real time only makes sense (and is only safe) with
+    // neither the sensors nor the elements real
+    if( !(mode_fake_in && mode_fake_out) && timing_speed() != 1 )
+        timing_set_speed(1);
+
+    // plausibility check of the measured response against the applied power;
+    // meaningless unless both the sensor and the outputs are real.  Without
+    // THERMAL_MONITOR the model still runs, for calibrating it ("slope")
+    if( mode_fake_in || mode_fake_out || state == ST_FAULT )
+    {
+        monitor_reset();
+    }
+    else
+    {
+        uint8_t mfault = monitor_update(temp_t,((uint16_t)cmd_t + cmd_b) >> 1);
+
+#ifndef THERMAL_MONITOR
+        mfault = MONITOR_OK;    // not calibrated for this oven: report only
+#endif
+
+        if(mfault != MONITOR_OK)
+        {
+            fault();
+            monitor_fault(mfault);
+        }
+    }
+
+    // the telemetry limits count control ticks, not ticks the host kept up
+    telem_tick();
+
     // produce status update message
     // (provided previous update has already been sent)
     if(!tx_len)
     {
-        // expensive.. but we're only running at 4 Hz, so we have cycles to burn
-        tx_len = sprintf_P(tx_msg,PSTR("%s,%u,%d,%d,%d,%u,%u,%u\n"),
-            state_names[state],
-            time,
-            target,
-            temp_t,
-            temp_b,
-            cmd,
-            cmd_t,
-            cmd_b);
+        s_status st;
+        uint32_t cycles_t = ssr_get_on_cycles(SSR_TOP);
+        uint32_t cycles_b = ssr_get_on_cycles(SSR_BOT);
+
+        st.state        = state;
+        st.time         = time;
+        st.target       = target;
+        st.temp_t       = temp_t;
+        st.temp_b       = temp_b;
+        st.cmd          = cmd;
+        st.cmd_t        = cmd_t;
+        st.cmd_b        = cmd_b;
+        st.locked       = timing_locked();
+        st.phase_err    = timing_phase_error();
+        st.wh_t         = ssr_energy_wh(SSR_TOP,cycles_t);
+        st.wh_b         = ssr_energy_wh(SSR_BOT,cycles_b);
+
+        char line[80];
+        int32_t values[TELEM_FIELDS] = {
+            st.state, st.time, st.target, st.temp_t, st.temp_b, st.cmd,
+            st.cmd_t, st.cmd_b, st.locked, st.phase_err,
+            (int32_t)st.wh_t, (int32_t)st.wh_b };
+
+        // only when something the host asked for has changed (or heartbeat)
+        if(telem_due(values) && tx_queue(line,status_format(line,&st)))
+            telem_sent(values);
+
+        // per-run energy report, once the profile completes
+        if(run_energy_pending)
+        {
+            uint32_t wh_t = ssr_energy_wh(SSR_TOP,cycles_t - run_cycles_t);
+            uint32_t wh_b = ssr_energy_wh(SSR_BOT,cycles_b - run_cycles_b);
+            char *p = line;
+
+            // "energy: %lu,%lu,%lu\n"
+            p = fmt_str_P(p,PSTR("energy: "));
+            p = fmt_u32(p,wh_t);            *p++ = ',';
+            p = fmt_u32(p,wh_b);            *p++ = ',';
+            p = fmt_u32(p,wh_t + wh_b);     *p++ = '\n';
+
+            tx_queue(line,p - line);
+            run_energy_pending = 0;
+        }
     }
     should_update_lcd=1;
     time++;
 
+    // control loop is alive
+    wdt_reset();
+
 }
 
 char rx_msg[255];
 uint8_t rx_cnt;
 
+// names for the "stats" dump, in oven_stats.h section order
+const char stat_name_lat[] PROGMEM = "isr_lat";
+const char stat_name_ssr[] PROGMEM = "ssr";
+const char stat_name_ctl[] PROGMEM = "control";
+const char stat_name_lcd[] PROGMEM = "lcd";
+const char stat_name_msg[] PROGMEM = "message";
+const char stat_name_wake[] PROGMEM = "wake_lat";
+PGM_P const stat_names[STAT_SECTIONS] PROGMEM = {
+    stat_name_lat, stat_name_ssr, stat_name_ctl, stat_name_lcd, stat_name_msg, stat_name_wake
+};
+
+// build options, as reported by "get: caps"
+const char caps_flags[] PROGMEM = ""
+#ifdef USE_THERMOCOUPLE
+    ",thermocouple"
+#endif
+#ifdef BOTTOM_THERM
+    ",bottom_therm"
+#endif
+#ifdef USE_THERMISTOR
+    ",thermistor"
+#endif
+#ifdef SENSOR_FUSION
+    ",sensor_fusion"
+#endif
+#ifdef ZERO_CROSS_SYNC
+    ",zero_cross_sync"
+#endif
+#ifdef IDLE_SLEEP
+    ",idle_sleep"
+#endif
+#ifdef CALIBRATION_PROFILE
+    ",calibration_profile"
+#endif
+#ifdef THERMAL_MONITOR
+    ",thermal_monitor"
+#endif
+    ;
+
+// everything "dump" reports, in order
+const char param_version[]      PROGMEM = "version";
+const char param_caps[]         PROGMEM = "caps";
+const char param_pid[]          PROGMEM = "pid";
+const char param_target[]       PROGMEM = "target";
+const char param_manual[]       PROGMEM = "manual";
+const char param_cmd[]          PROGMEM = "cmd";
+const char param_fake_in[]      PROGMEM = "fake_in";
+const char param_fake_out[]     PROGMEM = "fake_out";
+const char param_temp[]         PROGMEM = "temp";
+const char param_mains[]        PROGMEM = "mains";
+const char param_speed[]        PROGMEM = "speed";
+const char param_peak_limit[]   PROGMEM = "peak_limit";
+const char param_watts[]        PROGMEM = "watts";
+const char param_filter[]       PROGMEM = "filter";
+const char param_stream[]       PROGMEM = "stream";
+const char param_telemetry[]    PROGMEM = "telemetry";
+const char param_deadband[]     PROGMEM = "deadband";
+const char param_monitor[]      PROGMEM = "monitor";
+const char param_profile[]      PROGMEM = "profile";
+PGM_P const param_names[] PROGMEM = {
+    param_version, param_caps, param_pid, param_target, param_manual,
+    param_cmd, param_fake_in, param_fake_out, param_temp, param_mains, param_speed,
+    param_peak_limit, param_watts, param_filter, param_stream, param_telemetry,
+    param_deadband, param_monitor, param_profile
+};
+#define PARAMS (sizeof(param_names)/sizeof(param_names[0]))
+
+// read-back for "get: <name>" and "dump": replies "<name>: <values>", in the
+// form the matching command takes.  Returns 0 for an unknown name
+uint8_t get_param(const char *name)
+{
+    uint8_t i, a, b;
+    uint16_t mask;
+
+    if(strcmp_P(name,param_version) == 0) {
+        reply_P(PSTR("version: %u,%S %S\n"),PROTOCOL_VERSION,PSTR(__DATE__),PSTR(__TIME__));
+    } else if(strcmp_P(name,param_caps) == 0) {
+        // f_cpu, thermocouple devices, calibration points, build flags
+        reply_P(PSTR("caps: %lu,%u,%u%S\n"),F_CPU,DEVICES,CAL_POINTS,caps_flags);
+    } else if(strcmp_P(name,param_pid) == 0) {
+        reply_P(PSTR("pid: %u,%u,%u\n"),k_p,k_i,k_d);
+    } else if(strcmp_P(name,param_target) == 0) {
+        reply_P(PSTR("target: %d\n"),manual_target);
+    } else if(strcmp_P(name,param_manual) == 0) {
+        reply_P(PSTR("manual: %u\n"),mode_manual);
+    } else if(strcmp_P(name,param_cmd) == 0) {
+        reply_P(PSTR("cmd: %u,%u\n"),manual_cmd_t,manual_cmd_b);
+    } else if(strcmp_P(name,param_fake_in) == 0) {
+        reply_P(PSTR("fake_in: %u\n"),mode_fake_in);
+    } else if(strcmp_P(name,param_fake_out) == 0) {
+        reply_P(PSTR("fake_out: %u\n"),mode_fake_out);
+    } else if(strcmp_P(name,param_temp) == 0) {
+        reply_P(PSTR("temp: %d,%d\n"),fake_temp_t,fake_temp_b);
+    } else if(strcmp_P(name,param_mains) == 0) {
+        reply_P(PSTR("mains: %u,%u\n"),timing_mains_hz(),timing_ssr_window());
+    } else if(strcmp_P(name,param_speed) == 0) {
+        reply_P(PSTR("speed: %u\n"),timing_speed());
+    } else if(strcmp_P(name,param_peak_limit) == 0) {
+        reply_P(PSTR("peak_limit: %u\n"),ssr_get_max_on());
+    } else if(strcmp_P(name,param_watts) == 0) {
+        reply_P(PSTR("watts: %u,%u\n"),ssr_get_watts(SSR_TOP),ssr_get_watts(SSR_BOT));
+#ifdef USE_THERMOCOUPLE
+    } else if(strcmp_P(name,param_filter) == 0) {
+        max6675_get_filter(&a,&b);
+        reply_P(PSTR("filter: %u,%u\n"),a,b);
+#endif
+    } else if(strcmp_P(name,param_stream) == 0) {
+        reply_P(PSTR("stream: %u\n"),mode_stream);
+    } else if(strcmp_P(name,param_telemetry) == 0) {
+        telem_get(&mask,&a,&b);
+        reply_P(PSTR("telemetry: %x,%u,%u\n"),mask,a,b);
+    } else if(strcmp_P(name,param_deadband) == 0) {
+        // only the fields that have one
+        for(i=0;i<TELEM_FIELDS;i++)
+            if(telem_get_deadband(i))
+                reply_P(PSTR("deadband: %u,%u\n"),i,telem_get_deadband(i));
+    } else if(strcmp_P(name,param_monitor) == 0) {
+        uint16_t gain;
+        monitor_get_model(&gain,&a);
+        reply_P(PSTR("monitor: %u,%u\n"),gain,a);
+    } else if(strcmp_P(name,param_profile) == 0) {
+        // step, time steps, rate (1/1024 C per step), fan
+        uint16_t delta_time;
+        int16_t temp_rate;
+        for(i=0;profile_get_step(i,&delta_time,&temp_rate,&a);i++)
+            reply_P(PSTR("profile: %u,%u,%d,%u\n"),i,delta_time,temp_rate,a);
+    } else {
+        return 0;
+    }
+
+    return 1;
+}
+
 void process_message(const char *msg)
 {
     // this is a ridiculously expensive function to invoke - a more efficient
@@ -377,34 +845,349 @@ void process_message(const char *msg)
     // there isn't a lot of downside to this expensive-but-easy implementation
 
 
+    uint8_t mains_hz, mains_window, max_on, filt_median, filt_bits;
+    uint16_t watts_t, watts_b;
+    uint8_t cal_dev, cal_idx;
+    int16_t cal_raw, cal_temp;
+    uint16_t telem_mask;
+    uint8_t telem_min, telem_max, telem_field;
+    uint16_t telem_band;
+    uint16_t sp_time;
+    int16_t sp_target;
+    uint8_t sp_ok = 1;
+    uint16_t mon_gain;
+    uint8_t mon_loss;
+    uint8_t speed;
+    uint8_t gain_p, gain_i, gain_d;
+    int16_t temp_t, temp_b, target;
+    uint8_t cmd_t, cmd_b, flag, set;
+    uint32_t host;
+    char name[16];
+
+    // parse into locals with interrupts enabled - a single sscanf_P can run
+    // for longer than a mains half-cycle - and only disable them below, to
+    // copy the result into the state shared with the ISRs
+
+    // partial matches leave the remaining fields at their current values
+    temp_t = fake_temp_t; temp_b = fake_temp_b;
+    cmd_t = manual_cmd_t; cmd_b = manual_cmd_b;
+    mains_window = 0;
+    gain_p = k_p; gain_i = k_i; gain_d = k_d;
+
+    if(sscanf_P(msg,PSTR("temp: %d, %d"),&temp_t,&temp_b))
+        set = SET_TEMP;
+    else if(sscanf_P(msg,PSTR("cmd: %hhu, %hhu"),&cmd_t,&cmd_b))
+        set = SET_CMD;
+    else if(sscanf_P(msg,PSTR("target: %d"),&target))
+        set = SET_TARGET;
+    else if(sscanf_P(msg,PSTR("fake_out: %hhu"),&flag))
+        set = SET_FAKE_OUT;
+    else if(sscanf_P(msg,PSTR("fake_in: %hhu"),&flag))
+        set = SET_FAKE_IN;
+    else if(sscanf_P(msg,PSTR("manual: %hhu"),&flag))
+        set = SET_MANUAL;
+    else if(sscanf_P(msg,PSTR("pid: %hhu, %hhu, %hhu"),&gain_p,&gain_i,&gain_d))
+        set = SET_PID;
+    else if(sscanf_P(msg,PSTR("mains: %hhu, %hhu"),&mains_hz,&mains_window))
+        set = SET_MAINS;
+    else if(sscanf_P(msg,PSTR("peak_limit: %hhu"),&max_on))
+        set = SET_PEAK_LIMIT;
+    else if(sscanf_P(msg,PSTR("filter: %hhu, %hhu"),&filt_median,&filt_bits) == 2)
+        set = SET_FILTER;
+    else if(sscanf_P(msg,PSTR("watts: %u, %u"),&watts_t,&watts_b) == 2)
+        set = SET_WATTS;
+    else if(sscanf_P(msg,PSTR("sp: %u, %d"),&sp_time,&sp_target) == 2)
+        set = SET_SP;
+    else if(sscanf_P(msg,PSTR("stream: %hhu"),&flag) == 1)
+        set = SET_STREAM;
+    else if(sscanf_P(msg,PSTR("speed: %hhu"),&speed) == 1)
+        set = SET_SPEED;
+    else if(sscanf_P(msg,PSTR("ping: %lu"),&host) == 1)
+        set = SET_PING;
+    else if(sscanf_P(msg,PSTR("telemetry: %x, %hhu, %hhu"),&telem_mask,&telem_min,&telem_max) == 3)
+        set = SET_TELEMETRY;
+    else if(sscanf_P(msg,PSTR("deadband: %hhu, %u"),&telem_field,&telem_band) == 2)
+        set = SET_DEADBAND;
+    else if(sscanf_P(msg,PSTR("monitor: %u, %hhu"),&mon_gain,&mon_loss) == 2)
+        set = SET_MONITOR;
+    else if(strcmp_P(msg,PSTR("reset")) == 0)
+        set = SET_RESET;
+    else if(strcmp_P(msg,PSTR("go")) == 0)
+        set = SET_GO;
+    else if(strcmp_P(msg,PSTR("pause")) == 0)
+        set = SET_PAUSE;
+    else if(strcmp_P(msg,PSTR("resume")) == 0)
+        set = SET_RESUME;
+    else
+        set = SET_NONE;
+
     cli(); // temporarily disable interrupts to prevent any potential write errors
 
-    if(sscanf_P(msg,PSTR("temp: %d, %d"),&fake_temp_t,&fake_temp_b) || \
-       sscanf_P(msg,PSTR("cmd: %hhu, %hhu"),&manual_cmd_t,&manual_cmd_b) || \
-       sscanf_P(msg,PSTR("target: %d"),&manual_target) || \
-       sscanf_P(msg,PSTR("fake_out: %hhu"),&mode_fake_out) || \
-       sscanf_P(msg,PSTR("fake_in: %hhu"),&mode_fake_in) || \
-       sscanf_P(msg,PSTR("manual: %hhu"),&mode_manual) ||
-       sscanf_P(msg,PSTR("pid: %d, %d, %d"),&k_p, &k_i, &k_d)) {
-        ;
-    } else if(strcmp_P(msg,PSTR("reset")) == 0) {
-        comm_cmd = CMD_RESET;
-    } else if(strcmp_P(msg,PSTR("go")) == 0) {
-        comm_cmd = CMD_GO;
-    } else if(strcmp_P(msg,PSTR("pause")) == 0) {
-        comm_cmd = CMD_PAUSE;
-    } else if(strcmp_P(msg,PSTR("resume")) == 0) {
-        comm_cmd = CMD_RESUME;
+    switch(set) {
+        case SET_TEMP:
+            fake_temp_t = temp_t; fake_temp_b = temp_b;
+            break;
+        case SET_CMD:
+            manual_cmd_t = cmd_t; manual_cmd_b = cmd_b;
+            break;
+        case SET_TARGET:
+            manual_target = target;
+            break;
+        case SET_FAKE_OUT:
+            mode_fake_out = flag;
+            break;
+        case SET_FAKE_IN:
+            mode_fake_in = flag;
+            break;
+        case SET_MANUAL:
+            mode_manual = flag;
+            break;
+        case SET_PID:
+            pid_set_gains(gain_p,gain_i,gain_d);
+            break;
+        case SET_MAINS:
+            timing_configure(mains_hz,mains_window);
+            break;
+        case SET_PEAK_LIMIT:
+            ssr_set_max_on(max_on);
+            break;
+        case SET_FILTER:
+            max6675_set_filter(filt_median,filt_bits);
+            break;
+        case SET_WATTS:
+            ssr_set_watts(watts_t,watts_b);
+            break;
+        case SET_SP:
+            sp_ok = stream_push(sp_time,sp_target);
+            break;
+        case SET_STREAM:
+            // leaving (or re-entering) stream mode starts from an empty buffer
+            mode_stream = flag;
+            stream_clear();
+            break;
+        case SET_SPEED:
+            if(mode_fake_in && mode_fake_out)
+                timing_set_speed(speed);
+            break;
+        case SET_PING:
+            ping_host       = host;
+            ping_rx_time    = time - 1;
+            ping_rx_us      = timing_since_tick_us();
+            ping_pending    = 1;
+            break;
+        case SET_TELEMETRY:
+            telem_config(telem_mask,telem_min,telem_max);
+            break;
+        case SET_DEADBAND:
+            telem_deadband(telem_field,telem_band);
+            break;
+        case SET_MONITOR:
+            monitor_set_model(mon_gain,mon_loss);
+            break;
+        case SET_RESET:
+            comm_cmd = CMD_RESET;
+            break;
+        case SET_GO:
+            comm_cmd = CMD_GO;
+            break;
+        case SET_PAUSE:
+            comm_cmd = CMD_PAUSE;
+            break;
+        case SET_RESUME:
+            comm_cmd = CMD_RESUME;
+            break;
     }
 
     sei();
+
+    // a setpoint the buffer had no room for, or that wasn't after the last
+    // one: tell the streamer, with the time and the points queued
+    if(!sp_ok)
+        reply_P(PSTR("sp_refused: %u,%u\n"),sp_time,stream_count());
+
+    // queries are answered with interrupts enabled, since replies can block
+    if(strcmp_P(msg,PSTR("peak")) == 0) {
+        s_ssr_peak_stats peak;
+        ssr_get_peak_stats(&peak);
+        reply_P(PSTR("peak: %u,%u,%lu,%lu,%lu,%lu,%lu\n"),
+            ssr_get_max_on(),
+            peak.max_on,
+            peak.on_hist[0],
+            peak.on_hist[1],
+            peak.on_hist[2],
+            peak.deferred,
+            peak.dropped);
+    } else if(strcmp_P(msg,PSTR("stats")) == 0) {
+        // durations in Timer3 ticks, except isr_lat/wake_lat (Timer1 ticks,
+        // to be compared against the SSR deadline)
+        reply_P(PSTR("stats: ns_per_tick,%lu,%lu,%u\n"),
+            8000000UL/(F_CPU/1000),
+            64000000UL/(F_CPU/1000),
+            timing_ssr_deadline());
+        for(uint8_t i=0;i<STAT_SECTIONS;i++) {
+            s_stat st;
+            stats_get(i,&st);
+            reply_P(PSTR("stats: %S,%lu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n"),
+                (PGM_P)pgm_read_ptr(&stat_names[i]),
+                st.count,
+                st.count ? st.min : 0,
+                st.max,
+                st.hist[0],st.hist[1],st.hist[2],st.hist[3],
+                st.hist[4],st.hist[5],st.hist[6],st.hist[7]);
+        }
+    } else if(strcmp_P(msg,PSTR("load")) == 0) {
+        uint16_t load[LOAD_TASKS], idle;
+        load_get(load,&idle);
+        // control,ssr,usb_rx,usb_tx,lcd,thermistor,idle (percent)
+        reply_P(PSTR("load: %u.%u,%u.%u,%u.%u,%u.%u,%u.%u,%u.%u,%u.%u\n"),
+            load[LOAD_CONTROL]/10,      load[LOAD_CONTROL]%10,
+            load[LOAD_SSR]/10,          load[LOAD_SSR]%10,
+            load[LOAD_USB_RX]/10,       load[LOAD_USB_RX]%10,
+            load[LOAD_USB_TX]/10,       load[LOAD_USB_TX]%10,
+            load[LOAD_LCD]/10,          load[LOAD_LCD]%10,
+            load[LOAD_THERMISTOR]/10,   load[LOAD_THERMISTOR]%10,
+            idle/10,                    idle%10);
+#ifdef USE_THERMOCOUPLE
+    } else if(strcmp_P(msg,PSTR("tc")) == 0) {
+        // device,temp (0.25C),cold junction (1/16C),fault bits
+        for(uint8_t i=0;i<DEVICES;i++)
+            reply_P(PSTR("tc: %u,%d,%d,%u\n"),
+                i,
+                max6675_read(i),
+                max6675_cold_junction(i),
+                max6675_faults(i));
+#endif
+#ifdef USE_THERMOCOUPLE
+    } else if(sscanf_P(msg,PSTR("cal_point: %hhu, %hhu, %d, %d"),&cal_dev,&cal_idx,&cal_raw,&cal_temp) == 4) {
+        // EEPROM writes take a few ms each, so they're done out here
+        cal_set_point(cal_dev,cal_idx,cal_raw,cal_temp);
+    } else if(sscanf_P(msg,PSTR("cal_save: %hhu, %hhu"),&cal_dev,&cal_idx) == 2) {
+        reply_P(PSTR("cal_save: %u,%u\n"),cal_dev,cal_save(cal_dev,cal_idx));
+    } else if(sscanf_P(msg,PSTR("cal: %hhu"),&cal_dev) == 1) {
+        // count, then index,raw,corrected (0.25C) per point
+        int16_t raw[CAL_POINTS], temp[CAL_POINTS];
+        uint8_t count = cal_get(cal_dev,raw,temp);
+        reply_P(PSTR("cal: %u,%u\n"),cal_dev,count);
+        for(uint8_t i=0;i<count;i++)
+            reply_P(PSTR("cal: %u,%u,%d,%d\n"),cal_dev,i,raw[i],temp[i]);
+#endif
+    } else if(sscanf_P(msg,PSTR("get: %15s"),name) == 1) {
+        if(!get_param(name))
+            reply_P(PSTR("get: unknown\n"));
+    } else if(strcmp_P(msg,PSTR("dump")) == 0) {
+        for(uint8_t i=0;i<PARAMS;i++) {
+            strcpy_P(name,(PGM_P)pgm_read_ptr(&param_names[i]));
+            get_param(name);
+        }
+        reply_P(PSTR("dump: end\n"));
+    } else if(strcmp_P(msg,PSTR("mem")) == 0) {
+        // RAM in bytes: static data, bss, stack space, free now, least free
+        // since reset (per-module statics: "make ram")
+        s_mem_info mem;
+        mem_info(&mem);
+        reply_P(PSTR("mem: %u,%u,%u,%u,%u\n"),mem.data,mem.bss,mem.stack,mem.free_now,mem.free_min);
+    } else if(strcmp_P(msg,PSTR("slope")) == 0) {
+        // thermal monitor: observed and expected slope (1/256 C/s), average
+        // power (0-255) over the window, and the top temperature (0.25C)
+        reply_P(PSTR("slope: %d,%d,%u,%d\n"),
+            monitor_slope(),monitor_expected(),monitor_power(),temp_t);
+    } else if(strcmp_P(msg,PSTR("sp")) == 0) {
+        // streamed setpoints: mode, points queued, underruns
+        reply_P(PSTR("sp: %u,%u,%u\n"),mode_stream,stream_count(),stream_underruns());
+    } else if(strcmp_P(msg,PSTR("fmt_bench")) == 0) {
+        // time the status line both ways on a worst-case record (Timer3
+        // ticks per line, see "stats"; best of 4 so interrupts don't count),
+        // and check they agree byte for byte
+        s_status st = { ST_PAUSE, 65535, -32768, -32768, -32768, 255, 255, 255,
+                        255, -32768, 4294967295UL, 4294967295UL };
+        char a[80], b[80];
+        uint8_t i, len_a = 0, len_b = 0;
+        uint16_t t0, t, t_fmt = 0xFFFF, t_printf = 0xFFFF;
+
+        for(i=0;i<4;i++) {
+            t0 = stats_now();
+            len_a = status_format(a,&st);
+            t = stats_now() - t0;
+            if(t < t_fmt) t_fmt = t;
+
+            t0 = stats_now();
+            len_b = status_format_P(b,&st);
+            t = stats_now() - t0;
+            if(t < t_printf) t_printf = t;
+        }
+
+        reply_P(PSTR("fmt_bench: %u,%u,%u\n"),
+            t_printf,
+            t_fmt,
+            len_a == len_b && memcmp(a,b,len_a) == 0);
+    } else if(strcmp_P(msg,PSTR("stats_reset")) == 0) {
+        stats_reset();
+    }
 }
 
+// split a received block into new-line terminated commands
+void rx_assemble(const uint8_t *buf, uint8_t n)
+{
+    const uint8_t *nl;
+    uint8_t len;
+
+    while(n)
+    {
+        // all commands are terminated with a new-line
+        nl  = (const uint8_t*)memchr(buf,'\n',n);
+        len = nl ? nl - buf : n;
+
+        // buffer received characters; rx_cnt sticks at 255 once the line
+        // has overflowed the buffer, or held a NUL (which would hide the
+        // rest of it from the parser)
+        if(rx_cnt != 255) {
+            if(len < 255 - rx_cnt && !memchr(buf,'\0',len)) {
+                memcpy(rx_msg + rx_cnt,buf,len);
+                rx_cnt += len;
+            } else {
+                rx_cnt = 255;
+            }
+        }
+
+        if(!nl)
+            break;
+
+        // CR-LF from terminals
+        if(rx_cnt > 0 && rx_cnt < 255 && rx_msg[rx_cnt-1] == '\r')
+            rx_cnt--;
+
+        // only process commands that haven't overflowed the buffer
+        if(rx_cnt > 0 && rx_cnt < 255) {
+            uint16_t t0 = stats_now();
+            rx_msg[rx_cnt] = '\0';
+            process_message(rx_msg);
+            stats_record(STAT_MESSAGE, stats_now() - t0);
+        }
+        rx_cnt = 0;
+
+        len++;
+        buf += len;
+        n   -= len;
+    }
+}
+
+#ifdef __AVR__
+// a watchdog reset leaves the watchdog enabled (at its shortest timeout), so
+// it has to be turned off before the C runtime's data/bss set-up, let alone
+// the slow start-up in main(); .init3 runs just after the stack is set up
+void wdt_init(void) __attribute__((naked, used, section(".init3")));
+void wdt_init(void)
+{
+    MCUSR &= ~(_BV(WDRF));
+    wdt_disable();
+}
+#endif
+
 // program entry point
 int main(void)
 {
-    int16_t ret;
-    char c;
+    uint8_t rx_block[64], n;
+    s_load_mark mark;
 
     CLKPR = 0x80;
 #if (F_CPU == 16000000)
@@ -421,6 +1204,10 @@ int main(void)
     // initialize
     oven_setup();
 
+    // from here on the control tick must keep running (it resets the watchdog);
+    // if it stops, the chip resets with the SSR outputs off
+    wdt_enable(WDTO_1S);
+
 
     // sleep.  Makes the USB less cranky
     _delay_ms(2000);
@@ -439,53 +1226,71 @@ int main(void)
 
     lcd_host_dtr_wait();
 
+#ifdef IDLE_SLEEP
+    set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+
 
     // run forever
     while(1)
     {
-        // if the control loop has generated a status update message,
-        // send it out over USB to the host
+        // if the control loop has queued messages, send what the USB will
+        // take now; the rest goes on later passes
+        n = 0;
         if(tx_len  && is_usb_ready())
         {
-            usb_serial_write((const uint8_t*)tx_msg,tx_len);
-            tx_len = 0; // clear the length, so the control loop knows it can generate a new message
-        }else {
+            load_begin(&mark);
+            n = tx_send(0);
+            load_end(LOAD_USB_TX,&mark);
+        }
+
+        // the LCD waits for the USB, unless the host isn't reading
+        if(!n) {
             if (should_update_lcd){ // a full LCD update takes approx 2ms @16mhz as timed
+                load_begin(&mark);
                 lcd_update();
+                stats_record(STAT_LCD, load_end(LOAD_LCD,&mark));
                 should_update_lcd=0;
             } 
         }
 
-        if (is_usb_ready()){
-            // receive individual characters from the host
-            while( (ret = usb_serial_getchar()) != -1)
-            {
-                // all commands are terminated with a new-line
-                c = ret;
-                if(c == '\n') {
-                    // only process commands that haven't overflowed the buffer
-                    if(rx_cnt > 0 && rx_cnt < 255) {
-                        rx_msg[rx_cnt] = '\0';
-                        process_message(rx_msg);
-                    }
-                    rx_cnt = 0;
-                } else {
-                    // buffer received characters
-                    rx_msg[rx_cnt] = c;
-                    if(rx_cnt != 255) rx_cnt++;
-                }
-            }
+        if (is_usb_ready() && usb_serial_available()){
+            load_begin(&mark);
+            // receive whole packets from the host
+            while( (n = usb_serial_read(rx_block,sizeof(rx_block))) != 0 )
+                rx_assemble(rx_block,n);
+            load_end(LOAD_USB_RX,&mark);
         }
         
-#ifdef USE_THERMISTOR        
+#if defined(USE_THERMISTOR) && !defined(SENSOR_FUSION)
       // only support top therm for thermistor.  We use temp_b as our temporary variable
+      load_begin(&mark);
       temp_b=thermistor_read();
+      load_end(LOAD_THERMISTOR,&mark);
       if (temp_b!=temp_t){
         cli(); // prevent half reads
         temp_t=temp_b;
         sei();
         should_update_lcd=1;
       }      
+#endif
+
+#ifdef IDLE_SLEEP
+        // sleep until the next interrupt if nothing is pending.  Interrupts
+        // stay off between the check and the sleep (sei takes effect after
+        // the following instruction), so a wake-up can't slip in between
+        cli();
+        if(!should_update_lcd &&
+           !(is_usb_ready() && (tx_len || usb_serial_available())))
+        {
+            stats_asleep = 1;
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+            stats_asleep = 0;
+        }
+        sei();
 #endif    
         
     }
@@ -62,15 +62,23 @@ extern uint8_t is_usb_ready(void);
 // Do we have 2 thermocouple chips?  If not, top=bottom
 //#define BOTTOM_THERM
 
-// Device level moving average
-//#define TEMP_AVERAGING
-//#define AVERAGE_BITS 2
-//#define AVERAGE (1<<AVERAGE_BITS)
-
+// Device level filtering: median-of-N (1: off, 3 or 5) to reject single-sample
+// spikes, then a running average over 2^bits samples (0: off; averaging
+// slows the pid response).  Runtime: "filter: <median>, <bits>"
+#define DEFAULT_FILTER_MEDIAN   3
+#define DEFAULT_FILTER_BITS     0
+
+// Thermocouple chips (up to 8): chip-select port, pin, and TC_MAX6675 or
+// TC_MAX31855.  Device 0 is the top sensor, 1 the bottom with BOTTOM_THERM;
+// any others are only reported ("tc").  Chips are read round-robin from the
+// timer interrupt, each no faster than its conversion time
 #ifndef BOTTOM_THERM
 #define DEVICES 1
+#define TC_TABLE    { { &PORTB, 0, TC_MAX6675 } }
 #else
 #define DEVICES 2
+#define TC_TABLE    { { &PORTB, 0, TC_MAX6675 }, \
+                      { &PORTC, 6, TC_MAX6675 } }
 #endif
 
 
@@ -91,7 +99,74 @@ extern uint8_t is_usb_ready(void);
 // use ADC 7
 #define THERMISTOR_CHANNEL 7
 
+// fuse the thermocouple and thermistor into one temperature/rate estimate
+// for the pid (needs both USE_THERMOCOUPLE and USE_THERMISTOR)
+//#define SENSOR_FUSION
+
+#if defined(SENSOR_FUSION) && !(defined(USE_THERMOCOUPLE) && defined(USE_THERMISTOR))
+#error "SENSOR_FUSION needs USE_THERMOCOUPLE and USE_THERMISTOR"
+#endif
+
+
 
+// mains frequency (50 or 60) and SSR modulation window in half-cycles
+// (0: one control tick, i.e. 30 at 60Hz and 25 at 50Hz).  Both can be
+// changed at runtime with the "mains: <hz>, <window>" command
+#define DEFAULT_MAINS_HZ    60
+#define DEFAULT_SSR_WINDOW  0
+
+// maximum number of heating elements switched on in the same half-cycle
+// (0: unlimited).  1 interleaves top and bottom to halve peak current;
+// can be changed at runtime with "peak_limit: <n>"
+#define DEFAULT_SSR_MAX_ON  0
+
+// heating element ratings used for energy metering; "watts: <top>, <bot>"
+#define DEFAULT_WATTS_TOP   750
+#define DEFAULT_WATTS_BOT   750
+
+// SSR outputs are forced off (and latched until "reset") if the control
+// tick hasn't refreshed them within this many half-cycles (~0.75s at 60Hz)
+#define SSR_WATCHDOG_HALF_CYCLES    90
+
+// sensor faults (oven_fault.c): ignored for the first FAULT_MASK_TICKS
+// control ticks after power-up or "reset"; afterwards the oven shuts down
+// (ST_FAULT) once FAULT_DEBOUNCE_N of the last FAULT_DEBOUNCE_M (<= 8)
+// readings were bad.  Bad readings are replaced by the last good one
+#define FAULT_MASK_TICKS    12
+#define FAULT_DEBOUNCE_N    3
+#define FAULT_DEBOUNCE_M    8
+
+// thermal plausibility monitor (oven_monitor.c): the temperature slope,
+// fitted over MONITOR_WINDOW ticks, against a first-order model.  Rates in
+// 1/256 C/s: GAIN is the rise at full power, LOSS the cooling per 4C above
+// AMBIENT (0.25C units).  Faults after MONITOR_HOLD ticks (<= 255) of either
+// under a quarter of the expected rise at >= half power, or a rise above
+// RUNAWAY_RISE with the outputs off.
+// GAIN and LOSS depend on the oven, so the monitor only faults with
+// THERMAL_MONITOR defined, once they've been calibrated (README, "Thermal
+// monitor").  Runtime: "monitor: <gain>, <loss>"; "slope" reports the fit
+//#define THERMAL_MONITOR
+#define MONITOR_WINDOW          32
+#define DEFAULT_MONITOR_GAIN    256
+#define DEFAULT_MONITOR_LOSS    3
+#define MONITOR_AMBIENT         100
+#define MONITOR_MIN_RISE        64
+#define MONITOR_RUNAWAY_RISE    128
+#define MONITOR_HOLD            240
+
+// sleep (SLEEP_MODE_IDLE) in the main loop when there's nothing to do; the
+// timer, USB start-of-frame (1kHz) and ADC interrupts wake it
+#define IDLE_SLEEP
+
+// lock the SSR timer to a mains zero-cross detector on INT0 (PD0)
+// harmless without the detector: the timer just stays free-running
+#define ZERO_CROSS_SYNC
+
+
+
+// serial protocol version, reported by "get: version"; bump on incompatible
+// changes to commands or the status line
+#define PROTOCOL_VERSION    2
 
 // enable calibration profile as default
 
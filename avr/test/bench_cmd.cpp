@@ -0,0 +1,67 @@
+/*
+ * Command parser throughput (ovencon.cpp) on the PC, without the
+ * sanitizers: commands per second through rx_assemble and process_message,
+ * for commands early and late in the parser's chain, and for a line it
+ * doesn't recognise (which tries every one).  Only the relative numbers
+ * carry over to the AVR; "stats" gives the real per-message time there.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ovencon_host.h"
+
+static const char *const commands[] = {
+    "temp: 100, 200\n",             // first in the chain
+    "pid: 12, 4, 5\n",
+    "sp: 10, 400\n",
+    "deadband: 3, 4\n",             // last setter with arguments
+    "resume\n",                     // last setter
+    "get: pid\n",                   // a query (and its reply)
+    "unknown: 1, 2, 3\n",           // nothing matches
+};
+
+#define COMMANDS    (sizeof(commands)/sizeof(commands[0]))
+#define LINES       64              // per block from the host
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    static uint8_t block[LINES * 32];
+    double t0, t;
+    size_t i, len, n;
+    long blocks;
+
+    printf("%-20s %12s %10s\n", "command", "commands/s", "ns each");
+
+    for(i=0;i<COMMANDS;i++)
+    {
+        len = strlen(commands[i]);
+        for(n=0;n<LINES;n++)
+            memcpy(block + n*len,commands[i],len);
+
+        host_reset();
+
+        // ~0.1s each
+        t0 = now();
+        blocks = 0;
+        do {
+            host_rx(block,LINES*len);
+            blocks++;
+            t = now() - t0;
+        } while(t < 0.1);
+
+        printf("%-20.*s %12.0f %10.1f\n", (int)len-1, commands[i],
+            blocks * LINES / t, t * 1e9 / (blocks * LINES));
+    }
+
+    return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * Fuzzing the command parser (ovencon.cpp): arbitrary bytes from the host,
+ * in USB packets, with control ticks in between.  Built with the address
+ * and undefined-behaviour sanitizers, so any out-of-bounds access or
+ * overflow stops it; the controller's own invariants are checked after
+ * every packet.
+ *
+ * The standalone driver (main, below) runs the seed commands and then a
+ * fixed, repeatable sequence of mutations of them:
+ *
+ *   ./fuzz_cmd [runs]          mutate (default 200000 inputs)
+ *   ./fuzz_cmd file...         replay saved inputs
+ *
+ * LLVMFuzzerTestOneInput is libFuzzer's entry point, so the same file
+ * also builds for coverage-guided fuzzing, e.g. with clang:
+ *
+ *   clang++ -fsanitize=fuzzer,address,undefined -DLIBFUZZER ...
+ */
+
+#include <avr/io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ovencon.h"
+#include "oven_pid.h"
+#include "oven_timing.h"
+#include "ovencon_host.h"
+
+#define CHECK_OR_ABORT(cond, ...) do { \
+        if(!(cond)) { \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__); \
+            putchar('\n'); \
+            abort(); \
+        } \
+    } while(0)
+
+static void check_invariants(void)
+{
+    uint8_t hz = timing_mains_hz();
+
+    CHECK_OR_ABORT(SREG & 0x80, "interrupts left disabled");
+    CHECK_OR_ABORT(state <= 4, "state %u", state);
+    CHECK_OR_ABORT(k_p <= PID_MAX_SHIFT && k_i <= PID_MAX_SHIFT && k_d <= PID_MAX_SHIFT,
+        "gains %u,%u,%u", k_p, k_i, k_d);
+    CHECK_OR_ABORT(hz == 50 || hz == 60, "mains %u Hz", hz);
+    CHECK_OR_ABORT(timing_speed() >= 1 && timing_speed() <= TIMING_MAX_SPEED &&
+        (hz >> 1) % timing_speed() == 0, "speed %u at %u Hz", timing_speed(), hz);
+    CHECK_OR_ABORT(host_out_unterminated == 0, "%u writes didn't end a line",
+        (unsigned)host_out_unterminated);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    size_t n;
+
+    host_reset();
+
+    // a packet at a time, and a control tick (sending the status line)
+    // after each, so commands act on the state earlier ones left
+    while(size)
+    {
+        n = size < 64 ? size : 64;
+        host_rx(data,n);
+        check_invariants();
+
+        oven_update_4hz();
+        while(tx_send(0))
+            ;
+        check_invariants();
+
+        data += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+#ifndef LIBFUZZER
+
+// every command, and a few ways of getting the framing wrong
+#define SEED(s)     { s, sizeof(s)-1 }
+static const struct { const char *s; size_t n; } seeds[] = {
+    SEED("temp: 100, 200\n"),
+    SEED("temp: -32768\n"),
+    SEED("cmd: 255, 0\n"),
+    SEED("target: 720\n"),
+    SEED("fake_out: 1\n"),
+    SEED("fake_in: 1\n"),
+    SEED("manual: 1\n"),
+    SEED("pid: 12, 4, 5\n"),
+    SEED("pid: 255, 255, 255\n"),
+    SEED("mains: 50, 10\n"),
+    SEED("mains: 60\n"),
+    SEED("peak_limit: 1\n"),
+    SEED("filter: 5, 3\n"),
+    SEED("watts: 65535, 0\n"),
+    SEED("sp: 10, 400\n"),
+    SEED("stream: 1\n"),
+    SEED("speed: 8\n"),
+    SEED("ping: 4294967295\n"),
+    SEED("telemetry: ffff, 0, 255\n"),
+    SEED("deadband: 11, 65535\n"),
+    SEED("monitor: 65535, 255\n"),
+    SEED("reset\n"),
+    SEED("go\n"),
+    SEED("pause\n"),
+    SEED("resume\n"),
+    SEED("peak\n"),
+    SEED("stats\n"),
+    SEED("load\n"),
+    SEED("tc\n"),
+    SEED("cal_point: 0, 1, 400, 410\n"),
+    SEED("cal_save: 0, 2\n"),
+    SEED("cal: 0\n"),
+    SEED("get: version\n"),
+    SEED("get: caps\n"),
+    SEED("get: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n"),
+    SEED("dump\n"),
+    SEED("mem\n"),
+    SEED("sp\n"),
+    SEED("slope\n"),
+    SEED("get: monitor\n"),
+    SEED("fmt_bench\n"),
+    SEED("stats_reset\n"),
+    SEED("fake_in: 1\r\nfake_out: 1\r\nspeed: 7\r\nget: speed\r\n"),
+    SEED("stream: 1\nsp: 0, 100\nsp: 65535, -32768\ngo\n"),
+    SEED("get: \0version\n"),
+    SEED("\n\n\r\n"),
+    SEED(":\n"),
+    SEED("temp:\n"),
+};
+
+static uint32_t rng = 1;
+
+// xorshift32: the same inputs on every run
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+#define SEEDS       (sizeof(seeds)/sizeof(seeds[0]))
+#define MAX_INPUT   1024
+
+static size_t seed(uint8_t *buf, uint32_t i)
+{
+    i %= SEEDS;
+    memcpy(buf,seeds[i].s,seeds[i].n);
+    return seeds[i].n;
+}
+
+// a few random edits of a seed: byte changes (biased towards the
+// characters commands are made of), insertions, deletions, splices
+static size_t mutate(uint8_t *buf)
+{
+    static const char chars[] = "0123456789-, :\n\r\0xfu";
+    uint8_t other[MAX_INPUT];
+    size_t n = seed(buf,rand32()), m, at, edits = 1 + rand32() % 8;
+
+    while(edits--)
+    {
+        at = n ? rand32() % n : 0;
+        switch(rand32() % 6)
+        {
+            case 0:     // any byte
+                if(n) buf[at] = rand32();
+                break;
+            case 1:     // a likely one
+                if(n) buf[at] = chars[rand32() % (sizeof(chars)-1)];
+                break;
+            case 2:     // insert
+                if(n < MAX_INPUT) {
+                    memmove(buf+at+1,buf+at,n-at);
+                    buf[at] = chars[rand32() % (sizeof(chars)-1)];
+                    n++;
+                }
+                break;
+            case 3:     // delete a run
+                m = n - at ? 1 + rand32() % (n - at) : 0;
+                memmove(buf+at,buf+at+m,n-at-m);
+                n -= m;
+                break;
+            case 4:     // splice in another command
+                m = seed(other,rand32());
+                if(n + m <= MAX_INPUT) {
+                    memmove(buf+at+m,buf+at,n-at);
+                    memcpy(buf+at,other,m);
+                    n += m;
+                }
+                break;
+            case 5:     // repeat the whole thing (long lines, many commands)
+                if(2*n <= MAX_INPUT) {
+                    memcpy(buf+n,buf,n);
+                    n *= 2;
+                }
+                break;
+        }
+    }
+
+    return n;
+}
+
+static int replay(const char *filename)
+{
+    static uint8_t buf[1 << 16];
+    FILE *f = fopen(filename,"rb");
+    size_t n;
+
+    if(!f) {
+        perror(filename);
+        return 1;
+    }
+    n = fread(buf,1,sizeof(buf),f);
+    fclose(f);
+
+    LLVMFuzzerTestOneInput(buf,n);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t buf[MAX_INPUT];
+    long runs = 200000, i;
+
+    if(argc > 1 && strspn(argv[1],"0123456789") != strlen(argv[1])) {
+        for(i=1;i<argc;i++)
+            if(replay(argv[i]))
+                return 1;
+        printf("%s: %d inputs ok\n", __FILE__, argc-1);
+        return 0;
+    }
+    if(argc > 1)
+        runs = atol(argv[1]);
+
+    for(i=0;i<(long)SEEDS;i++)
+        LLVMFuzzerTestOneInput(buf,seed(buf,i));
+
+    for(i=0;i<runs;i++)
+        LLVMFuzzerTestOneInput(buf,mutate(buf));
+
+    printf("%s: %ld inputs ok\n", __FILE__, (long)SEEDS + runs);
+    return 0;
+}
+
+#endif
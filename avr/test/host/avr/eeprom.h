@@ -0,0 +1,27 @@
+/*
+ * Host stand-in for <avr/eeprom.h>: EEMEM data is ordinary RAM (starting
+ * out zeroed, not erased, which the firmware treats as invalid either way).
+ */
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EEMEM
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+uint8_t eeprom_read_byte(const uint8_t *p);
+uint16_t eeprom_read_word(const uint16_t *p);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_byte(uint8_t *p, uint8_t v);
+void eeprom_update_word(uint16_t *p, uint16_t v);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for <avr/interrupt.h>: interrupts are just functions the
+ * tests can call, and the global enable is the I bit of the SREG variable.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#ifdef __cplusplus
+#define ISR(v, ...) extern "C" void v(void); extern "C" void v(void)
+#else
+#define ISR(v, ...) void v(void); void v(void)
+#endif
+
+#define sei()   (SREG |= 0x80)
+#define cli()   (SREG &= (uint8_t)~0x80)
+
+#endif
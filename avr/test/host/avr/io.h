@@ -0,0 +1,117 @@
+/*
+ * Host stand-in for <avr/io.h>: just enough of the atmega32u4 for the
+ * firmware modules to compile and run on a PC.  Registers are plain
+ * variables (defined in host.c) that the tests can poke.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define HOST_REGS8(X) \
+    X(SPCR) X(SPSR) X(SPDR) \
+    X(TCCR1A) X(TCCR1B) X(TCCR1C) X(TIMSK1) X(TIFR1) \
+    X(TCCR3A) X(TCCR3B) X(TIMSK3) X(TIFR3) \
+    X(EICRA) X(EIMSK) X(EIFR) \
+    X(ADMUX) X(ADCSRA) X(ADCSRB) \
+    X(CLKPR) X(MCUSR) X(WDTCSR) X(SMCR) X(SREG)
+
+#define HOST_REGS16(X) \
+    X(TCNT1) X(ICR1) X(OCR1A) X(OCR1B) X(TCNT3) X(OCR3A) X(ADC) X(SP)
+
+#define HOST_DECLARE8(r)    extern volatile uint8_t r;
+#define HOST_DECLARE16(r)   extern volatile uint16_t r;
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+HOST_REGS8(HOST_DECLARE8)
+HOST_REGS16(HOST_DECLARE16)
+extern volatile uint8_t host_ports[15];
+#ifdef __cplusplus
+}
+#endif
+
+// each port's PINx, DDRx and PORTx are consecutive, as on the chip (the
+// firmware finds DDRx one below PORTx)
+#define PINB    host_ports[0]
+#define DDRB    host_ports[1]
+#define PORTB   host_ports[2]
+#define PINC    host_ports[3]
+#define DDRC    host_ports[4]
+#define PORTC   host_ports[5]
+#define PIND    host_ports[6]
+#define DDRD    host_ports[7]
+#define PORTD   host_ports[8]
+#define PINE    host_ports[9]
+#define DDRE    host_ports[10]
+#define PORTE   host_ports[11]
+#define PINF    host_ports[12]
+#define DDRF    host_ports[13]
+#define PORTF   host_ports[14]
+
+#define _BV(b)              (1u << (b))
+#define bit_is_set(r,b)     ((r) & _BV(b))
+#define bit_is_clear(r,b)   (!((r) & _BV(b)))
+// nothing sets the hardware flags here: peripherals finish at once
+#define loop_until_bit_is_set(r,b)      do{}while(0)
+#define loop_until_bit_is_clear(r,b)    do{}while(0)
+
+#define RAMSTART    0x100
+#define RAMEND      0xAFF
+#define E2END       0x3FF
+
+// SPI
+#define SPR0    0
+#define SPR1    1
+#define CPHA    2
+#define CPOL    3
+#define MSTR    4
+#define DORD    5
+#define SPE     6
+#define SPIE    7
+#define SPI2X   0
+#define SPIF    7
+
+// timers
+#define WGM10   0
+#define WGM11   1
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define WGM13   4
+#define CS30    0
+#define CS31    1
+#define CS32    2
+#define OCIE1A  1
+#define OCF1A   1
+#define OCIE3A  1
+#define OCF3A   1
+
+// external interrupts
+#define ISC00   0
+#define ISC01   1
+#define INT0    0
+#define INTF0   0
+
+// ADC
+#define REFS0   6
+#define REFS1   7
+#define ADPS0   0
+#define ADPS1   1
+#define ADPS2   2
+#define ADIE    3
+#define ADIF    4
+#define ADSC    6
+#define ADEN    7
+
+// system
+#define CLKPS0  0
+#define CLKPCE  7
+#define WDRF    3
+#define SE      0
+#define SM0     1
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>: there is one address space, so the
+ * _P functions are their RAM equivalents.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P               const char *
+#define PSTR(s)             (s)
+#define pgm_read_byte(a)    (*(const uint8_t *)(a))
+#define pgm_read_word(a)    (*(const uint16_t *)(a))
+#define pgm_read_dword(a)   (*(const uint32_t *)(a))
+#define pgm_read_ptr(a)     (*(const void * const *)(a))
+
+#define sprintf_P           host_sprintf_P
+#define snprintf_P          host_snprintf_P
+#define vsnprintf_P         host_vsnprintf_P
+#define sscanf_P            host_sscanf_P
+#define strcmp_P            strcmp
+#define strncmp_P           strncmp
+#define strlen_P            strlen
+#define strcpy_P            strcpy
+#define memcpy_P            memcpy
+
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+// as on the AVR: int is 16 bits and long 32, and %S is a string in flash
+int host_vsnprintf_P(char *buf, size_t size, const char *fmt, va_list ap);
+int host_snprintf_P(char *buf, size_t size, const char *fmt, ...);
+int host_sprintf_P(char *buf, const char *fmt, ...);
+int host_sscanf_P(const char *str, const char *fmt, ...);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
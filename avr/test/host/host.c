@@ -0,0 +1,136 @@
+/*
+ * Host side of the stand-in avr headers: register variables, EEPROM access
+ * and the avr-libc printf/scanf format differences.
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <stdarg.h>
+
+#define HOST_DEFINE8(r)     volatile uint8_t r;
+#define HOST_DEFINE16(r)    volatile uint16_t r;
+
+HOST_REGS8(HOST_DEFINE8)
+HOST_REGS16(HOST_DEFINE16)
+volatile uint8_t host_ports[15];
+
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+    return *p;
+}
+
+uint16_t eeprom_read_word(const uint16_t *p)
+{
+    return *p;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    memcpy(dst,src,n);
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t v)
+{
+    *p = v;
+}
+
+void eeprom_update_word(uint16_t *p, uint16_t v)
+{
+    *p = v;
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    memcpy(dst,src,n);
+}
+
+
+// Rewrite an avr-libc format string for the host C library.  On the AVR
+// int is 16 bits and long 32, so: scanf's plain integer conversions store
+// shorts ("%u" -> "%hu"), and "l" conversions are the host's plain ones
+// ("%lu" -> "%u").  printf needs only the latter (shorter arguments are
+// promoted to int anyway).  %S is a string in flash, which here is %s.
+static const char *host_format(char *out, size_t size, const char *fmt, int scan)
+{
+    char *p = out, *end = out + size - 4;
+
+    while(*fmt && p < end)
+    {
+        if((*p++ = *fmt++) != '%')
+            continue;
+        if(*fmt == '%') {
+            *p++ = *fmt++;
+            continue;
+        }
+
+        // flags, width, precision, assignment suppression
+        while(*fmt && strchr("-+ #0123456789.*",*fmt) && p < end)
+            *p++ = *fmt++;
+
+        if(*fmt == 'h') {
+            *p++ = *fmt++;
+            if(*fmt == 'h')
+                *p++ = *fmt++;
+        } else if(*fmt == 'l') {
+            fmt++;
+        } else if(scan && *fmt && strchr("diouxX",*fmt)) {
+            *p++ = 'h';
+        }
+
+        if(*fmt == 'S') {
+            *p++ = 's';
+            fmt++;
+        }
+    }
+    *p = '\0';
+
+    return out;
+}
+
+int host_vsnprintf_P(char *buf, size_t size, const char *fmt, va_list ap)
+{
+    char f[256];
+
+    return vsnprintf(buf,size,host_format(f,sizeof(f),fmt,0),ap);
+}
+
+int host_snprintf_P(char *buf, size_t size, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap,fmt);
+    n = host_vsnprintf_P(buf,size,fmt,ap);
+    va_end(ap);
+
+    return n;
+}
+
+// (the AVR callers size their buffers for the result; so does this)
+int host_sprintf_P(char *buf, const char *fmt, ...)
+{
+    char f[256];
+    va_list ap;
+    int n;
+
+    va_start(ap,fmt);
+    n = vsprintf(buf,host_format(f,sizeof(f),fmt,0),ap);
+    va_end(ap);
+
+    return n;
+}
+
+int host_sscanf_P(const char *str, const char *fmt, ...)
+{
+    char f[256];
+    va_list ap;
+    int n;
+
+    va_start(ap,fmt);
+    n = vsscanf(str,host_format(f,sizeof(f),fmt,1),ap);
+    va_end(ap);
+
+    return n;
+}
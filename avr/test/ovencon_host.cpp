@@ -0,0 +1,132 @@
+/*
+ * Stand-ins for the parts of the firmware that only make sense on the
+ * board: the USB serial port (always configured, with the host listening
+ * and taking everything sent), the LCD, and the RAM accounting.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "usb_serial.h"
+#include "oven_lcd.h"
+#include "oven_mem.h"
+#include "ovencon_host.h"
+
+char host_out[4096];
+size_t host_out_len;
+uint32_t host_out_unterminated;
+
+static const uint8_t *rx_ptr;
+static size_t rx_left;
+
+
+static void host_write(const uint8_t *buf, uint16_t size)
+{
+    if(size && buf[size-1] != '\n')
+        host_out_unterminated++;
+
+    // keep the latest output, for the harnesses to look at
+    if(host_out_len + size > sizeof(host_out))
+        host_out_len = 0;
+    if(size <= sizeof(host_out)) {
+        memcpy(host_out + host_out_len,buf,size);
+        host_out_len += size;
+    }
+}
+
+void usb_init(void)
+{
+}
+
+uint8_t usb_configured(void)
+{
+    return 1;
+}
+
+uint8_t usb_serial_get_control(void)
+{
+    return USB_SERIAL_DTR;
+}
+
+uint8_t usb_serial_available(void)
+{
+    return rx_left ? 1 : 0;
+}
+
+void usb_serial_flush_input(void)
+{
+    rx_left = 0;
+}
+
+// up to one full-speed packet, like the real thing
+uint8_t usb_serial_read(uint8_t *buffer, uint8_t size)
+{
+    uint8_t n = rx_left < size ? rx_left : size;
+
+    if(n > 64)
+        n = 64;
+    memcpy(buffer,rx_ptr,n);
+    rx_ptr  += n;
+    rx_left -= n;
+
+    return n;
+}
+
+int8_t usb_serial_write(const uint8_t *buffer, uint16_t size)
+{
+    host_write(buffer,size);
+    return 0;
+}
+
+uint8_t usb_serial_write_nowait(const uint8_t *buffer, uint8_t size)
+{
+    host_write(buffer,size);
+    return size;
+}
+
+
+void lcd_init()
+{
+}
+
+void lcd_usb_found_wait()
+{
+}
+
+void lcd_host_dtr_wait()
+{
+}
+
+void lcd_update()
+{
+}
+
+
+void mem_info(s_mem_info *info)
+{
+    memset(info,0,sizeof(*info));
+}
+
+
+void host_reset(void)
+{
+    sei();
+    oven_setup();
+    rx_cnt          = 0;
+    rx_left         = 0;
+    host_out_len    = 0;
+    host_out_unterminated = 0;
+}
+
+// as the main loop receives it
+void host_rx(const uint8_t *buf, size_t n)
+{
+    uint8_t block[64], len;
+
+    rx_ptr  = buf;
+    rx_left = n;
+    while(usb_serial_available())
+        while( (len = usb_serial_read(block,sizeof(block))) != 0 )
+            rx_assemble(block,len);
+}
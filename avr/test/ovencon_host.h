@@ -0,0 +1,36 @@
+/*
+ * The whole firmware on the PC, for exercising the command parser: the
+ * parts of ovencon.cpp the harnesses drive, and the stand-in USB serial
+ * port (ovencon_host.cpp) that collects what the controller sends.
+ */
+
+#ifndef OVENCON_HOST_H_INCLUDED
+#define OVENCON_HOST_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ovencon.cpp
+void oven_setup(void);
+void oven_update_4hz(void);
+void process_message(const char *msg);
+void rx_assemble(const uint8_t *buf, uint8_t n);
+uint8_t tx_send(uint8_t wait);
+extern uint8_t rx_cnt;
+extern volatile uint8_t tx_len;
+extern volatile uint8_t state;
+extern volatile uint8_t k_p, k_i, k_d;
+
+// everything written to the USB port since host_reset(), and the number
+// of writes that didn't end a line (replies go out a line at a time)
+extern char host_out[4096];
+extern size_t host_out_len;
+extern uint32_t host_out_unterminated;
+
+// oven_setup() from cold, with interrupts enabled and the host listening
+void host_reset(void);
+
+// a block from the host, split into USB packets as usb_serial_read would
+void host_rx(const uint8_t *buf, size_t n);
+
+#endif
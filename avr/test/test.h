@@ -0,0 +1,27 @@
+/*
+ * Minimal checks for the host tests: each test is a program that prints
+ * the failed checks and exits non-zero if there were any.
+ */
+
+#ifndef TEST_H_INCLUDED
+#define TEST_H_INCLUDED
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond, ...) do { \
+        if(!(cond)) { \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            printf(__VA_ARGS__); \
+            putchar('\n'); \
+            test_failures++; \
+        } \
+    } while(0)
+
+#define TEST_EXIT() do { \
+        printf("%s: %s\n", __FILE__, test_failures ? "FAILED" : "ok"); \
+        return test_failures ? 1 : 0; \
+    } while(0)
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Median prefilter, running average and fine output (oven_filter.c).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "test.h"
+#include "../oven_filter.h"
+
+static int cmp16(const void *a, const void *b)
+{
+    return *(const int16_t *)a - *(const int16_t *)b;
+}
+
+// with no averaging, the output is the median of the last n samples:
+// check every sequence of n samples drawn from n distinct values (and
+// repeats), so every ordering reaches every ring position
+static void check_median_exhaustive(uint8_t n)
+{
+    s_filter f;
+    int16_t seq[5], sorted[5];
+    uint32_t i, total = 1, bad = 0;
+    uint8_t k;
+
+    for(k=0;k<n;k++)
+        total *= n;
+
+    for(i=0;i<total;i++)
+    {
+        uint32_t v = i;
+        int16_t out = 0;
+
+        filter_init(&f,n,0,0);
+        for(k=0;k<n;k++) {
+            seq[k] = (v % n) * 10;
+            v /= n;
+            out = filter_update(&f,seq[k]);
+        }
+
+        for(k=0;k<n;k++)
+            sorted[k] = seq[k];
+        qsort(sorted,n,sizeof(sorted[0]),cmp16);
+
+        if(out != sorted[n/2] && bad++ < 5)
+            CHECK(0, "median-of-%u of %d,%d,%d,%d,%d: %d, not %d", n,
+                seq[0], seq[1], seq[2], n > 3 ? seq[3] : 0, n > 4 ? seq[4] : 0,
+                out, sorted[n/2]);
+    }
+}
+
+// a single spike (two for median-of-5) never gets through, wherever it
+// lands in the ring
+static void check_spikes(uint8_t n)
+{
+    s_filter f;
+    uint8_t pos, i, width;
+
+    for(width=1;width<=n/2;width++)
+    for(pos=0;pos<2*n;pos++)
+    {
+        filter_init(&f,n,2,400);
+
+        for(i=0;i<pos;i++)
+            filter_update(&f,400);
+        for(i=0;i<width;i++)
+            CHECK(filter_update(&f,4000) == 400, "median-of-%u, %u-sample spike at %u", n, width, pos);
+        for(i=0;i<2*n;i++)
+            CHECK(filter_update(&f,400) == 400, "median-of-%u, after %u-sample spike at %u", n, width, pos);
+        CHECK(filter_fine(&f) == 1600, "median-of-%u, fine %d after spike at %u", n, filter_fine(&f), pos);
+    }
+}
+
+// on a ramp the median is just the middle sample: the ramp comes through
+// delayed by n/2 samples, without distortion
+static void check_ramp(uint8_t n)
+{
+    s_filter f;
+    int16_t i, out;
+
+    filter_init(&f,n,0,0);
+    for(i=1;i<100;i++) {
+        out = filter_update(&f,i*4);
+        if(i > n)
+            CHECK(out == (i - n/2)*4, "median-of-%u ramp at %d: %d", n, i, out);
+    }
+}
+
+static void check_average(void)
+{
+    s_filter f;
+    int16_t i, out = 0;
+
+    // a step through a 2^3 running average takes 8 samples, linearly
+    filter_init(&f,1,3,0);
+    for(i=1;i<=8;i++) {
+        out = filter_update(&f,800);
+        CHECK(out == i*100, "average step %d: %d", i, out);
+    }
+
+    // fine output: the sum of the last four samples (1/16C for 0.25C input)
+    filter_init(&f,1,0,0);
+    filter_update(&f,401);
+    filter_update(&f,402);
+    filter_update(&f,402);
+    filter_update(&f,403);
+    CHECK(filter_fine(&f) == 1608, "fine %d", filter_fine(&f));
+
+    // out-of-range settings are clamped
+    filter_init(&f,9,9,0);
+    CHECK(f.median == 5 && f.bits == FILTER_MAX_BITS, "clamped to %u,%u", f.median, f.bits);
+    filter_init(&f,2,0,0);
+    CHECK(f.median == 1, "median-of-2 is %u", f.median);
+}
+
+int main(void)
+{
+    check_median_exhaustive(3);
+    check_median_exhaustive(5);
+    check_spikes(3);
+    check_spikes(5);
+    check_ramp(3);
+    check_ramp(5);
+    check_average();
+
+    TEST_EXIT();
+}
@@ -0,0 +1,65 @@
+/*
+ * Thermal plausibility monitor (oven_monitor.c) against a simulated
+ * first-order oven: a weak oven that levels off near reflow peak trips
+ * the default model, but not one calibrated to it; a sensor that has
+ * come off trips either way.
+ */
+
+#include <stdint.h>
+#include "test.h"
+#include "ovencon.h"
+#include "../oven_monitor.h"
+
+// heat at full power for up to 10 minutes, from ambient; gain and loss as
+// the model takes them.  Returns the first fault (tick count in *ticks)
+static uint8_t run(double gain, double loss, uint8_t sensor_off, int *ticks)
+{
+    double t = MONITOR_AMBIENT;     // 0.25C
+    uint8_t fault = MONITOR_OK;
+    int i;
+
+    monitor_reset();
+    for(i=0;i<10*60*4 && fault == MONITOR_OK;i++) {
+        // C/s, which is also 0.25C per 0.25s tick
+        t += (gain - loss * (t - MONITOR_AMBIENT) / 16) / 256;
+        fault = monitor_update(sensor_off ? MONITOR_AMBIENT : (int16_t)t, 255);
+    }
+    *ticks = i;
+
+    return fault;
+}
+
+int main(void)
+{
+    uint16_t gain;
+    uint8_t loss, fault;
+    int ticks;
+
+    monitor_setup();
+    monitor_get_model(&gain,&loss);
+    CHECK(gain == DEFAULT_MONITOR_GAIN && loss == DEFAULT_MONITOR_LOSS, "defaults %u,%u", gain, loss);
+
+    // an oven matching the default model never trips
+    fault = run(DEFAULT_MONITOR_GAIN,DEFAULT_MONITOR_LOSS,0,&ticks);
+    CHECK(fault == MONITOR_OK, "default oven: fault %u after %d ticks", fault, ticks);
+
+    // 100/256 C/s at full power, levelling off at 230C
+    fault = run(100,100.0*16/(920-MONITOR_AMBIENT),0,&ticks);
+    CHECK(fault == MONITOR_NO_RESPONSE, "weak oven, default model: fault %u", fault);
+
+    monitor_set_model(100,2);
+    fault = run(100,100.0*16/(920-MONITOR_AMBIENT),0,&ticks);
+    CHECK(fault == MONITOR_OK, "weak oven, calibrated: fault %u after %d ticks", fault, ticks);
+
+    // sensor off: no response to full power
+    fault = run(100,2,1,&ticks);
+    CHECK(fault == MONITOR_NO_RESPONSE, "sensor off: fault %u", fault);
+    CHECK(ticks <= MONITOR_WINDOW + MONITOR_HOLD, "sensor off: fault after %d ticks", ticks);
+
+    // any model the host can set: no overflow (UBSan), output in range
+    monitor_set_model(65535,255);
+    fault = run(100,2,0,&ticks);
+    CHECK(monitor_expected() <= INT16_MAX, "expected %d", monitor_expected());
+
+    TEST_EXIT();
+}
@@ -0,0 +1,66 @@
+/*
+ * PID arithmetic (oven_pid.c): the command stays saturated, in the right
+ * direction, at the largest gains and errors, and the integral recovers.
+ * UBSan catches any overflow along the way.
+ */
+
+#include <stdint.h>
+#include "test.h"
+#include "../oven_pid.h"
+
+int main(void)
+{
+    uint8_t cmd, i;
+    int n;
+
+    pid_reset();
+    pid_set_gains(255,255,255);
+    pid_set_gains(PID_MAX_SHIFT,PID_MAX_SHIFT,PID_MAX_SHIFT);
+
+    // far too cold, temperature falling as fast as it can
+    for(n=0;n<100000;n++) {
+        cmd = pid_update_d(-32768,32767,32767);
+        if(cmd != 255)
+            break;
+    }
+    CHECK(n == 100000, "cold: command %u after %d steps", cmd, n);
+
+    // far too hot: the integral mustn't have wound up past recovery
+    cmd = pid_update_d(32767,-32768,-32768);
+    CHECK(cmd == 0, "hot: command %u", cmd);
+    for(n=0;n<100000;n++) {
+        cmd = pid_update_d(32767,-32768,-32768);
+        if(cmd != 0)
+            break;
+    }
+    CHECK(n == 100000, "hot: command %u after %d steps", cmd, n);
+
+    // small error at the defaults: an ordinary, unsaturated command
+    pid_reset();
+    pid_set_gains(12,4,5);
+    cmd = pid_update_d(400,401,0);
+    CHECK(cmd == 8, "1 count error: command %u", cmd);
+
+    // each gain alone, every shift big enough to saturate, both signs
+    for(i=2;i<=PID_MAX_SHIFT;i++) {
+        pid_reset();
+        pid_set_gains(i,0,0);
+        CHECK(pid_update_d(0,32767,0) == 255, "k_p %u, +", i);
+        pid_reset();
+        CHECK(pid_update_d(0,-32768,0) == 0, "k_p %u, -", i);
+        pid_reset();
+        pid_set_gains(0,0,i);
+        CHECK(pid_update_d(0,0,-32768) == 0, "k_d %u, -", i);
+    }
+
+    // a step across the whole fine range: the fitted rise saturates rather
+    // than wrapping round to a fall, so the derivative still holds it off
+    pid_reset();
+    pid_set_gains(0,0,0);
+    for(i=0;i<PID_SLOPE_WINDOW;i++)
+        pid_update_fine(-32768,-8192);
+    cmd = pid_update_fine(32767,8192);
+    CHECK(cmd == 0, "full-range step: command %u", cmd);
+
+    TEST_EXIT();
+}
@@ -0,0 +1,177 @@
+/*
+ * Zero-cross PLL (oven_pll.c) against simulated mains edges: the Timer1
+ * model wraps at ICR1+1 ticks and reloads ICR1 from the PLL at the compare
+ * match, as the interrupts in oven_timing.c do.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include "test.h"
+#include "../oven_pll.h"
+
+#define TICKS_PER_S     (F_CPU / 8.0)                   // Timer1 at clk/8
+#define NOMINAL(hz)     ((uint16_t)((F_CPU / 16) / (hz)) - 1)   // TOP, as oven_timing.c
+#define COMPARE(top)    ((top) - ((top) / 6))
+#define LOCK_WINDOW     (150 * (F_CPU / 8000000))
+
+typedef struct
+{
+    double      hz;         // mains frequency
+    double      wander;     // +/- fraction the frequency wanders by...
+    double      wander_s;   // ...over this many seconds
+    double      jitter;     // +/- edge timing noise (timer ticks)
+    double      phase;      // first edge, as a fraction of a half-cycle
+    double      drop_at;    // no edges for drop_len seconds from here
+    double      drop_len;
+} s_mains;
+
+typedef struct
+{
+    double      lock_time;  // seconds to first lock; negative if never
+    int         unlocks;    // times lock was lost after first lock
+    int         max_err;    // largest |phase error| while locked
+    int         fallbacks;  // times the PLL gave up for lack of edges
+    int         locked_mid; // locked halfway through the dropout
+    int         locked_end;
+} s_result;
+
+static uint32_t rand_state = 12345;
+
+static double noise(void)
+{
+    rand_state = rand_state * 1103515245u + 12345u;
+    return ((rand_state >> 8) & 0xFFFF) / 32768.0 - 1.0;
+}
+
+static s_result simulate(uint16_t nominal, const s_mains *m, double seconds)
+{
+    s_pll pll;
+    s_result r = { -1.0, 0, 0, 0, -1, 0 };
+    double wrap = 0, edge, seen, end = seconds * TICKS_PER_S;
+    double drop_from = m->drop_at * TICKS_PER_S;
+    double drop_to = (m->drop_at + m->drop_len) * TICKS_PER_S;
+    uint16_t icr = nominal;
+    int compared = 0, was_locked = 0;
+
+    pll_reset(&pll,nominal);
+
+    edge = m->phase * TICKS_PER_S / (2 * m->hz);
+    seen = edge + m->jitter * noise();
+
+    while(wrap < end)
+    {
+        double cmp = wrap + COMPARE(nominal);
+        double next_wrap = wrap + icr + 1;
+
+        if(seen < next_wrap && (compared || seen < cmp))
+        {
+            if(seen < drop_from || seen >= drop_to)
+            {
+                pll_edge(&pll,(uint16_t)(seen - wrap),icr);
+
+                if(pll.locked) {
+                    int err = pll.phase_err < 0 ? -pll.phase_err : pll.phase_err;
+                    if(r.lock_time < 0)
+                        r.lock_time = seen / TICKS_PER_S;
+                    if(err > r.max_err)
+                        r.max_err = err;
+                } else if(was_locked) {
+                    r.unlocks++;
+                }
+                was_locked = pll.locked;
+            }
+            else if(r.locked_mid < 0 && seen >= (drop_from + drop_to) / 2)
+            {
+                r.locked_mid = pll.locked;
+            }
+
+            // next half-cycle at the (wandering) mains frequency
+            {
+                double t = edge / TICKS_PER_S;
+                double hz = m->hz;
+                if(m->wander_s > 0)
+                    hz *= 1 + m->wander * sin(2 * M_PI * t / m->wander_s);
+                edge += TICKS_PER_S / (2 * hz);
+                seen = edge + m->jitter * noise();
+            }
+        }
+        else if(!compared && cmp < next_wrap)
+        {
+            // compare match: load the next period, watch for lost edges
+            icr = pll.period;
+            if(pll_period_elapsed(&pll)) {
+                icr = nominal;
+                r.fallbacks++;
+                was_locked = 0;
+            }
+            compared = 1;
+        }
+        else
+        {
+            wrap = next_wrap;
+            compared = 0;
+        }
+    }
+
+    r.locked_end = pll.locked;
+    return r;
+}
+
+static void check_locks(const char *name, uint16_t nominal, const s_mains *m, double within)
+{
+    s_result r = simulate(nominal,m,20);
+
+    CHECK(r.lock_time >= 0 && r.lock_time < within, "%s: locked after %.2fs", name, r.lock_time);
+    CHECK(r.unlocks == 0, "%s: lost lock %d times", name, r.unlocks);
+    CHECK(r.max_err < LOCK_WINDOW, "%s: phase error %d while locked", name, r.max_err);
+    CHECK(r.fallbacks == 0, "%s: fell back %d times", name, r.fallbacks);
+    CHECK(r.locked_end, "%s: not locked at the end", name);
+}
+
+int main(void)
+{
+    s_mains m;
+    s_result r;
+    int i;
+
+    // steady mains from any starting phase
+    for(i=0;i<8;i++) {
+        m = (s_mains){ 60, 0, 0, 0, i / 8.0, 0, 0 };
+        check_locks("60Hz",NOMINAL(60),&m,1.0);
+        m.hz = 50;
+        check_locks("50Hz",NOMINAL(50),&m,1.0);
+    }
+
+    // off-frequency mains, within the pull range
+    m = (s_mains){ 60 * 1.01, 0, 0, 0, 0.3, 0, 0 };
+    check_locks("60Hz +1%",NOMINAL(60),&m,2.0);
+    m.hz = 60 * 0.99;
+    check_locks("60Hz -1%",NOMINAL(60),&m,2.0);
+
+    // frequency wandering +/-0.5% over 5s, with +/-20us of edge jitter
+    m = (s_mains){ 60, 0.005, 5, 20 * TICKS_PER_S / 1e6, 0.6, 0, 0 };
+    check_locks("60Hz wander+jitter",NOMINAL(60),&m,2.0);
+    m.hz = 50;
+    check_locks("50Hz wander+jitter",NOMINAL(50),&m,2.0);
+
+    // a few missing edges: the period is held and lock kept
+    m = (s_mains){ 60, 0, 0, 10 * TICKS_PER_S / 1e6, 0.2, 5, 0.02 };
+    r = simulate(NOMINAL(60),&m,10);
+    CHECK(r.fallbacks == 0, "short dropout: fell back %d times", r.fallbacks);
+    CHECK(r.unlocks == 0, "short dropout: lost lock %d times", r.unlocks);
+    CHECK(r.locked_end, "short dropout: not locked at the end");
+
+    // mains gone for a second: back to the nominal period, then relock
+    m = (s_mains){ 60 * 1.005, 0, 0, 10 * TICKS_PER_S / 1e6, 0.2, 5, 1 };
+    r = simulate(NOMINAL(60),&m,10);
+    CHECK(r.fallbacks == 1, "long dropout: fell back %d times", r.fallbacks);
+    CHECK(r.locked_mid == 0, "long dropout: still locked without edges");
+    CHECK(r.locked_end, "long dropout: didn't relock");
+
+    // 50Hz mains on a 60Hz setting is out of range and never locks
+    m = (s_mains){ 50, 0, 0, 0, 0.5, 0, 0 };
+    r = simulate(NOMINAL(60),&m,20);
+    CHECK(r.lock_time < 0, "wrong mains: locked after %.2fs", r.lock_time);
+
+    TEST_EXIT();
+}
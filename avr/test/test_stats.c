@@ -0,0 +1,118 @@
+/*
+ * Section timing and CPU load accounting (oven_stats.c), driven by setting
+ * the Timer3 count by hand.
+ */
+
+#include <avr/io.h>
+#include <stdint.h>
+#include "test.h"
+#include "../oven_stats.h"
+
+#define I_BIT   0x80
+
+static void check_stats(void)
+{
+    s_stat s;
+    uint16_t i;
+
+    stats_reset();
+    stats_get(STAT_SSR,&s);
+    CHECK(s.count == 0 && s.min == 0xFFFF && s.max == 0, "reset: %u %u %u", (unsigned)s.count, s.min, s.max);
+
+    // bucket n holds 2^n..2^(n+1)-1 (0 goes in the first), the last is open
+    stats_record(STAT_SSR,0);
+    stats_record(STAT_SSR,1);
+    stats_record(STAT_SSR,2);
+    stats_record(STAT_SSR,3);
+    stats_record(STAT_SSR,4);
+    stats_record(STAT_SSR,127);
+    stats_record(STAT_SSR,128);
+    stats_record(STAT_SSR,60000);
+    stats_get(STAT_SSR,&s);
+    CHECK(s.count == 8, "count %u", (unsigned)s.count);
+    CHECK(s.min == 0 && s.max == 60000, "min %u max %u", s.min, s.max);
+    CHECK(s.hist[0] == 2 && s.hist[1] == 2 && s.hist[2] == 1, "low buckets %u %u %u", s.hist[0], s.hist[1], s.hist[2]);
+    CHECK(s.hist[6] == 1 && s.hist[STAT_BUCKETS-1] == 2, "high buckets %u %u", s.hist[6], s.hist[STAT_BUCKETS-1]);
+
+    // other sections untouched
+    stats_get(STAT_LCD,&s);
+    CHECK(s.count == 0, "LCD count %u", (unsigned)s.count);
+
+    // histogram buckets saturate rather than wrap
+    for(i=0;i<0xFFFF;i++)
+        stats_record(STAT_LCD,5);
+    stats_record(STAT_LCD,5);
+    stats_get(STAT_LCD,&s);
+    CHECK(s.hist[2] == 0xFFFF && s.count == 0x10000, "saturation %u %u", s.hist[2], (unsigned)s.count);
+}
+
+static void check_load(void)
+{
+    s_load_mark outer, inner;
+    uint16_t permille[LOAD_TASKS], idle, dur;
+
+    TCNT3 = 0;
+    stats_setup();
+    load_tick();
+
+    // control task from 0 to 1000, interrupted by the SSR update 100-300
+    TCNT3 = 0;
+    load_begin(&outer);
+    TCNT3 = 100;
+    load_begin(&inner);
+    TCNT3 = 300;
+    dur = load_end(LOAD_SSR,&inner);
+    CHECK(dur == 200, "inner %u", dur);
+    TCNT3 = 1000;
+    dur = load_end(LOAD_CONTROL,&outer);
+    CHECK(dur == 1000, "outer %u (inclusive)", dur);
+
+    TCNT3 = 10000;
+    load_tick();
+    load_get(permille,&idle);
+    CHECK(permille[LOAD_CONTROL] == 80, "control %u", permille[LOAD_CONTROL]);
+    CHECK(permille[LOAD_SSR] == 20, "ssr %u", permille[LOAD_SSR]);
+    CHECK(idle == 900, "idle %u", idle);
+
+    // a task spanning the Timer3 wrap
+    TCNT3 = 65000;
+    load_tick();
+    load_begin(&outer);
+    TCNT3 = 500;
+    dur = load_end(LOAD_LCD,&outer);
+    CHECK(dur == 1036, "wrapped %u", dur);
+
+    // the window halves rather than overflowing, keeping the proportions:
+    // LCD busy a quarter of the time for a long while
+    stats_setup();
+    {
+        uint32_t t;
+        uint16_t now = 0;
+        for(t=0;t<(1UL<<24);t+=40000) {
+            TCNT3 = now;
+            load_begin(&outer);
+            TCNT3 = now += 10000;
+            load_end(LOAD_LCD,&outer);
+            TCNT3 = now += 30000;
+            load_tick();
+        }
+    }
+    load_get(permille,&idle);
+    CHECK(permille[LOAD_LCD] >= 249 && permille[LOAD_LCD] <= 251, "long run lcd %u", permille[LOAD_LCD]);
+    CHECK(idle >= 749 && idle <= 751, "long run idle %u", idle);
+}
+
+int main(void)
+{
+    // every call must leave the interrupt flag as it found it
+    SREG = I_BIT;
+    check_stats();
+    check_load();
+    CHECK(SREG == I_BIT, "interrupts left %s", (SREG & I_BIT) ? "on" : "off");
+    SREG = 0;
+    stats_record(STAT_SSR,1);
+    load_tick();
+    CHECK(SREG == 0, "interrupts turned on");
+
+    TEST_EXIT();
+}
@@ -0,0 +1,49 @@
+/*
+ * Streamed setpoints (oven_stream.c): interpolation across the full target
+ * range and across the time wrap, and the points stream_push refuses.
+ */
+
+#include <stdint.h>
+#include "test.h"
+#include "../oven_stream.h"
+
+int main(void)
+{
+    int16_t t;
+    uint8_t i;
+
+    // the widest step there is: the difference doesn't fit 16 bits
+    stream_clear();
+    stream_push(0,INT16_MIN);
+    stream_push(4,INT16_MAX);
+    t = stream_update(2,0);
+    CHECK(t == -1 || t == 0, "midpoint %d", t);
+    t = stream_update(3,0);
+    CHECK(t > 16000, "3/4 %d", t);
+
+    stream_clear();
+    stream_push(0,INT16_MAX);
+    stream_push(4,INT16_MIN);
+    t = stream_update(1,0);
+    CHECK(t > 16000, "1/4 down %d", t);
+
+    // times wrap with the status line
+    stream_clear();
+    stream_push(65534,400);
+    stream_push(2,800);
+    t = stream_update(0,0);
+    CHECK(t == 600, "across the wrap %d", t);
+
+    // refusals: out of order, repeated, full
+    stream_clear();
+    CHECK(stream_push(10,400), "first");
+    CHECK(!stream_push(10,400), "same time accepted");
+    CHECK(!stream_push(9,400), "earlier time accepted");
+    for(i=1;i<STREAM_POINTS;i++)
+        CHECK(stream_push(10 + i,400), "point %u", i);
+    CHECK(stream_count() == STREAM_POINTS, "count %u", stream_count());
+    CHECK(!stream_push(100,400), "accepted when full");
+    CHECK(stream_count() == STREAM_POINTS, "count after refusal %u", stream_count());
+
+    TEST_EXIT();
+}
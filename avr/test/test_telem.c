@@ -0,0 +1,62 @@
+/*
+ * Status line scheduling (oven_telem.c): deadbands, rate limits and the
+ * heartbeat, counted in control ticks.
+ */
+
+#include <stdint.h>
+#include "test.h"
+#include "../oven_telem.h"
+
+static int32_t values[TELEM_FIELDS];
+
+// one control tick; the line goes out only if the host has kept up
+static uint8_t tick(uint8_t host_ready)
+{
+    telem_tick();
+    if(host_ready && telem_due(values)) {
+        telem_sent(values);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    uint8_t i, sent;
+
+    // defaults: every tick
+    telem_reset();
+    for(i=0;i<4;i++)
+        CHECK(tick(1), "default tick %u not sent", i);
+
+    // temperature (field 3) only, 1C deadband, 2..8 ticks apart
+    telem_config(1 << 3,2,8);
+    telem_deadband(3,4);
+    CHECK(tick(1), "first tick after config not sent");
+
+    values[3] += 4;
+    CHECK(!tick(1), "sent before min ticks");
+    CHECK(!tick(1), "sent within the deadband");
+    values[5] += 100;   // not in the mask
+    CHECK(!tick(1), "sent for a field not in the mask");
+    values[3] += 1;
+    CHECK(tick(1), "change past the deadband not sent");
+
+    // heartbeat after max ticks with nothing changing
+    for(sent=0,i=0;i<20 && !sent;i++)
+        sent = tick(1);
+    CHECK(i == 8, "heartbeat after %u ticks", i);
+
+    // ticks the host was too slow for still count towards the limits: a
+    // line is due as soon as the queue drains, not max ticks later
+    for(i=0;i<8;i++)
+        CHECK(!tick(0), "sent while the host was busy");
+    CHECK(tick(1), "not sent once the host caught up");
+
+    // and the minimum spacing too
+    values[3] += 100;
+    CHECK(!tick(0), "sent while the host was busy");
+    CHECK(tick(1), "change not sent %u ticks after the last line", 2);
+
+    TEST_EXIT();
+}
@@ -369,6 +369,42 @@ int16_t usb_serial_getchar(void)
 	return c;
 }
 
+// receive a block: copies up to size bytes of the current packet in a
+// single critical section, returns the number of bytes (0 if none)
+uint8_t usb_serial_read(uint8_t *buffer, uint8_t size)
+{
+	uint8_t c, n, intr_state;
+
+	intr_state = SREG;
+	cli();
+	if (!usb_configuration) {
+		SREG = intr_state;
+		return 0;
+	}
+	UENUM = CDC_RX_ENDPOINT;
+	retry:
+	c = UEINTX;
+	if (!(c & (1<<RWAL))) {
+		// no data in buffer
+		if (c & (1<<RXOUTI)) {
+			UEINTX = 0x6B;
+			goto retry;
+		}	
+		SREG = intr_state;
+		return 0;
+	}
+	// take as much of the packet as fits
+	n = UEBCLX;
+	if (n > size) n = size;
+	for (c = n; c; c--) {
+		*buffer++ = UEDATX;
+	}
+	// if buffer completely used, release it
+	if (!(UEINTX & (1<<RWAL))) UEINTX = 0x6B;
+	SREG = intr_state;
+	return n;
+}
+
 // number of bytes available in the receive buffer
 uint8_t usb_serial_available(void)
 {
@@ -621,6 +657,36 @@ int8_t usb_serial_write(const uint8_t *buffer, uint16_t size)
 }
 
 
+// transmit as much of a buffer as fits in the current packet, without
+// waiting for the host; returns the number of bytes taken (0 if the
+// packet is still waiting to go, or not configured).  Callers keep the
+// rest and try again later
+uint8_t usb_serial_write_nowait(const uint8_t *buffer, uint8_t size)
+{
+	uint8_t intr_state, write_size, n;
+
+	if (!usb_configuration) return 0;
+	intr_state = SREG;
+	cli();
+	UENUM = CDC_TX_ENDPOINT;
+	if (!(UEINTX & (1<<RWAL))) {
+		SREG = intr_state;
+		return 0;
+	}
+	transmit_previous_timeout = 0;
+	// compute how many bytes will fit into this packet
+	write_size = CDC_TX_SIZE - UEBCLX;
+	if (write_size > size) write_size = size;
+	for (n = write_size; n; n--) {
+		UEDATX = *buffer++;
+	}
+	// if this completed a packet, transmit it now!
+	if (!(UEINTX & (1<<RWAL))) UEINTX = 0x3A;
+	transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
+	SREG = intr_state;
+	return write_size;
+}
+
 // immediately transmit any buffered output.
 // This doesn't actually transmit the data - that is impossible!
 // USB devices only transmit when the host allows, so the best
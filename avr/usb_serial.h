@@ -14,6 +14,7 @@ uint8_t usb_configured(void);		// is the USB port configured
 
 // receiving data
 int16_t usb_serial_getchar(void);	// receive a character (-1 if timeout/error)
+uint8_t usb_serial_read(uint8_t *buffer, uint8_t size); // receive up to one packet
 uint8_t usb_serial_available(void);	// number of bytes in receive buffer
 void usb_serial_flush_input(void);	// discard any buffered input
 
@@ -21,6 +22,7 @@ void usb_serial_flush_input(void);	// discard any buffered input
 int8_t usb_serial_putchar(uint8_t c);	// transmit a character
 int8_t usb_serial_putchar_nowait(uint8_t c);  // transmit a character, do not wait
 int8_t usb_serial_write(const uint8_t *buffer, uint16_t size); // transmit a buffer
+uint8_t usb_serial_write_nowait(const uint8_t *buffer, uint8_t size); // transmit what fits, do not wait
 void usb_serial_flush_output(void);	// immediately transmit any buffered output
 
 // serial parameters
@@ -31,7 +31,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 # depends on python-qt4, python-qwt5-qt4, python-serial
 from PyQt4 import QtGui, QtCore
 import PyQt4.Qwt5 as Qwt
+import csv
 import math
+import os
 import sys
 import serial
 import time
@@ -39,6 +41,9 @@ import time
 class OvenMsg():
     """Class representing a single status message sent from the oven control hardware."""
 
+    STATES  = ('fault','idle','run','done','pause')     # state_names[] on the controller
+    FIELDS  = (8,10,12)                                 # status line lengths, oldest first
+
     def __init__(self):
         """Sets sane default message contents."""
         self.state      = 'idle'
@@ -49,12 +54,17 @@ class OvenMsg():
         self.cmd        = 0.0
         self.cmd_t      = 0.0
         self.cmd_b      = 0.0
+        self.zc_lock    = 0
+        self.zc_err     = 0
+        self.wh_t       = 0
+        self.wh_b       = 0
+        self.wallclock  = None
 
     def parse(self,msg):
         """Parses message contents from a comma-separated string.
         
-        On microcontroller, message is generated with the C code:
-        sprintf_P(tx_msg,PSTR("%s,%u,%d,%d,%d,%u,%u,%u\\n"),
+        On microcontroller, message is generated by status_format(), equivalent to:
+        sprintf_P(tx_msg,PSTR("%s,%u,%d,%d,%d,%u,%u,%u,%u,%d,%lu,%lu\\n"),
             state_names[state],
             time,
             target,
@@ -62,25 +72,127 @@ class OvenMsg():
             temp_b,
             cmd,
             cmd_t,
-            cmd_b);
+            cmd_b,
+            timing_locked(),
+            timing_phase_error(),
+            ssr_energy_wh(SSR_TOP,cycles_t),
+            ssr_energy_wh(SSR_BOT,cycles_b));
         
-        This parses that."""
+        This parses that.  Older firmware only sends the first 8 or 10 fields.
+        Anything else (replies to queries, which start "<name>: ") is
+        rejected, so the caller can treat it as such."""
 
-        m               = msg.split(',')
-        if(len(m) != 8):
+        m               = msg.strip().split(',')
+        if(len(m) not in self.FIELDS or m[0] not in self.STATES):
             return 0
         
-        self.state      = m.pop(0)
-        self.time       = int(m.pop(0))*0.25
-        self.target     = int(m.pop(0))*0.25
-        self.sense_t    = int(m.pop(0))*0.25
-        self.sense_b    = int(m.pop(0))*0.25
-        self.cmd        = int(m.pop(0))/255.0
-        self.cmd_t      = int(m.pop(0))/255.0
-        self.cmd_b      = int(m.pop(0))/255.0
+        try:
+            values = [int(v) for v in m[1:]]
+        except ValueError:
+            return 0
+
+        self.state      = m[0]
+        self.time       = values.pop(0)*0.25
+        self.target     = values.pop(0)*0.25
+        self.sense_t    = values.pop(0)*0.25
+        self.sense_b    = values.pop(0)*0.25
+        self.cmd        = values.pop(0)/255.0
+        self.cmd_t      = values.pop(0)/255.0
+        self.cmd_b      = values.pop(0)/255.0
+
+        if(len(values) >= 2):
+            self.zc_lock    = values.pop(0)
+            self.zc_err     = values.pop(0)
+        if(len(values) >= 2):
+            self.wh_t       = values.pop(0)
+            self.wh_b       = values.pop(0)
+
+        return 1
+
+
+class OvenClock():
+    """Tracks the offset and drift of the controller's clock against host wall-clock time.
+
+    The host periodically sends "ping: <stamp>"; the controller answers from its
+    next control tick with "pong: <stamp>,<rx_time>,<rx_us>,<tx_time>,<tx_us>",
+    where the times are status-line time fields (0.25s ticks) plus microseconds
+    since that tick started.  Each exchange gives an NTP-style offset sample;
+    a line fitted through the quickest exchanges gives offset and drift."""
+
+    TICK    = 0.25  # seconds per control tick
+    SAMPLES = 32    # exchanges kept for the fit
+
+    def __init__(self):
+        self.sent       = {}    # stamp -> host send time
+        self.samples    = []    # (host time, offset, round trip)
+        self.ticks      = None  # last device tick count seen (unwrapped)
+        self.offset     = None  # device - host, at host time t0
+        self.drift      = 0.0   # change in offset per second
+        self.t0         = 0.0
+        self.rtt        = None  # last round trip, less the time held on the device
+        self.latency    = None  # last command-to-action time on the device
+
+    def ping_message(self):
+        """Returns a ping command, remembering when it was sent."""
+        now = time.time()
+        stamp = int(now*1000) & 0xFFFFFFFF
+        self.sent[stamp] = now
+        for old in sorted(self.sent)[:-16]:
+            del self.sent[old]
+        return "ping: %d" % (stamp)
+
+    def unwrap(self, ticks):
+        """Extends a 16-bit device tick count, assuming it is within half a wrap of the last one seen."""
+        if(self.ticks is None):
+            self.ticks = ticks
+        else:
+            self.ticks += ((ticks - self.ticks + 32768) % 65536) - 32768
+        return self.ticks
+
+    def pong(self, msg, received):
+        """Adds the exchange answered by a pong message received at host time received."""
+        m = msg.split(':',1)[1].split(',')
+        if(len(m) < 5):
+            return 0
+        stamp,rx_time,rx_us,tx_time,tx_us = [int(x) for x in m[:5]]
+        sent = self.sent.pop(stamp, None)
+        if(sent is None):
+            return 0
 
+        d_rx = self.unwrap(rx_time)*self.TICK + rx_us*1e-6
+        d_tx = self.unwrap(tx_time)*self.TICK + tx_us*1e-6
+
+        self.latency    = d_tx - d_rx
+        self.rtt        = (received - sent) - self.latency
+        offset          = ((d_rx - sent) + (d_tx - received)) / 2.0
+
+        self.samples.append(((sent + received) / 2.0, offset, self.rtt))
+        self.samples = self.samples[-self.SAMPLES:]
+        self.fit()
         return 1
 
+    def fit(self):
+        """Least-squares line through the samples with the lowest round trips
+        (the others were held up one way or the other, skewing their offsets)."""
+        best = min([x[2] for x in self.samples])
+        use = [x for x in self.samples if x[2] <= 2*best + 0.002]
+
+        self.t0 = sum([x[0] for x in use]) / len(use)
+        self.offset = sum([x[1] for x in use]) / len(use)
+        self.drift = 0.0
+
+        stt = sum([(x[0] - self.t0)**2 for x in use])
+        if(len(use) >= 2 and stt > 0):
+            self.drift = sum([(x[0] - self.t0)*(x[1] - self.offset) for x in use]) / stt
+
+    def wallclock(self, device_time):
+        """Host wall-clock time of a status-line time (seconds), or None before the first pong."""
+        if(self.offset is None):
+            return None
+        # device = host + offset + drift*(host - t0)
+        t = self.unwrap(int(round(device_time/self.TICK)))*self.TICK
+        return (t - self.offset + self.drift*self.t0) / (1.0 + self.drift)
+
 
 class OvenCommThread(QtCore.QThread):
     """Thread class responsible for asynchronously receiving messages from oven controller on behalf of OvenComm instance."""
@@ -99,9 +211,15 @@ class OvenCommThread(QtCore.QThread):
     def run(self):
         """Triggers newMessage signal in parent OvenComm instance whenever a message is received."""
         while(self.running):
+            line = self.p.s.readline()
+            if(line.startswith('pong:')):
+                self.p.clock.pong(line,time.time())
+                continue
             msg = OvenMsg()
-            if(msg.parse(self.p.s.readline()) and self.running):
+            if(msg.parse(line) and self.running):
                 self.p.trigger_newMessage(msg)
+            elif(': ' in line):
+                self.p.record_info(line)
 
     def stop(self):
         """Tells comm thread to stop running (eventually)."""
@@ -131,9 +249,21 @@ class OvenComm(QtCore.QObject):
         self.s.flushInput()
         self.s.readline()
 
+        self.clock = OvenClock()
+        self.info = {}
+
         self.thread = OvenCommThread(self)
         self.thread.start()
 
+        # discover what the controller is and how it's set up
+        self.s.write("dump\n")
+
+        # keep the clock estimate fresh
+        self.ping_timer = QtCore.QTimer(self)
+        self.ping_timer.timeout.connect(self.ping)
+        self.ping_timer.start(5000)
+        self.ping()
+
         self.v_cmd_t = 0
         self.v_cmd_b = 0
 
@@ -153,10 +283,26 @@ class OvenComm(QtCore.QObject):
     def trigger_newMessage(self,msg):
         """Callback for triggering Qt signals on receipt of new message by OvenCommThread."""
 
+        msg.wallclock = self.clock.wallclock(msg.time)
         self.newSenseT.emit(msg.sense_t)
         self.newSenseB.emit(msg.sense_b)
         self.newMessage.emit(msg)
 
+    def record_info(self,line):
+        """Keeps "<name>: <values>" replies (from get/dump) in self.info, as
+        a list of value lists per name (most names have one line)."""
+        name,values = line.strip().split(': ',1)
+        if(name == 'dump'):
+            return
+        rows = self.info.setdefault(name,[])
+        if(name not in ('profile','deadband','tc','cal','stats','sp_refused')):
+            del rows[:]
+        rows.append(values.split(','))
+
+    def ping(self):
+        """Sends a clock synchronisation ping (see OvenClock)."""
+        print >> self.s, self.clock.ping_message()
+
     def go(self):
         """Callback for Go button - resets controller and starts reflow operation."""
         self.s.write("reset\ngo\n")
@@ -211,6 +357,41 @@ class OvenComm(QtCore.QObject):
             t = 4095
         print >> self.s, "target: %d" % (t)
 
+    def telemetry(self,fields=0xFFF,min_interval=0.25,max_interval=0.25,deadbands={}):
+        """Sets when the controller sends status lines.
+
+        A line is sent when one of the fields (bit n = nth field of the
+        status line) moves by more than its deadband (dict of field number
+        to raw units), at most every min_interval and at least every
+        max_interval seconds.  The defaults send every control tick."""
+        for field,band in deadbands.items():
+            print >> self.s, "deadband: %d, %d" % (field,band)
+        print >> self.s, "telemetry: %x, %d, %d" % (fields,
+            max(1,min(255,int(min_interval*4))),
+            max(1,min(255,int(max_interval*4))))
+
+    def calibrate(self,device,points):
+        """Stores a thermocouple calibration in the controller's EEPROM.
+
+        points is a list of up to 8 (reading, actual) pairs in degrees C,
+        sorted by reading; an empty list removes the calibration."""
+        for i,(raw,actual) in enumerate(points):
+            print >> self.s, "cal_point: %d, %d, %d, %d" % (device,i,int(raw*4),int(actual*4))
+        print >> self.s, "cal_save: %d, %d" % (device,len(points))
+
+    def stream(self,enable):
+        """Switches the idle target to follow streamed setpoints (see
+        setpoint); either way the controller's setpoint buffer is emptied."""
+        print >> self.s, "stream: %d" % (1 if enable else 0)
+
+    def setpoint(self,tick,temp):
+        """Queues a streamed setpoint: temp degrees C at control tick tick
+        (the status line's time).  The controller interpolates between
+        points, so send them a few seconds ahead and in order.  A point the
+        controller refuses (buffer full, or not after the last point) comes
+        back as [tick, points queued] in self.info['sp_refused']."""
+        print >> self.s, "sp: %d, %d" % (int(tick) & 0xFFFF,int(temp*4))
+
 
 class OvenLogger():
     """Class for logging oven status messages to CSV files."""
@@ -234,7 +415,7 @@ class OvenLogger():
             self.f.close()
         filename = time.strftime('ovenlog_%Y%m%d%H%M%S.csv')
         self.f = open(filename,'a')
-        print >> self.f, "state,time,target,sense_t,sense_b,cmd,cmd_t,cmd_b"
+        print >> self.f, "state,time,target,sense_t,sense_b,cmd,cmd_t,cmd_b,wallclock"
 
     def log_message(self,msg):
         """Callback for newMessage signals - writes messages to log file.
@@ -251,7 +432,135 @@ class OvenLogger():
             self.time_offset = msg.time
 
         self.prevstate = msg.state
-        print >> self.f, "%s,%f,%f,%f,%f,%f,%f,%f" % (msg.state,msg.time-self.time_offset,msg.target,msg.sense_t,msg.sense_b,msg.cmd,msg.cmd_t,msg.cmd_b)
+        wallclock = "%.3f" % (msg.wallclock) if msg.wallclock is not None else ""
+        print >> self.f, "%s,%f,%f,%f,%f,%f,%f,%f,%s" % (msg.state,msg.time-self.time_offset,msg.target,msg.sense_t,msg.sense_b,msg.cmd,msg.cmd_t,msg.cmd_b,wallclock)
+
+
+class OvenReplay(QtCore.QObject):
+    """Replays a recorded log (as written by OvenLogger) through the controller.
+
+    The controller is put in fake_in/fake_out mode and fed the log's
+    temperatures one control tick at a time, along with the go/reset/
+    pause/resume and idle target changes the log implies; its status lines
+    are captured next to the recorded ones so a firmware change can be
+    diffed against the run that was logged.  speed > 1 runs the control
+    ticks that many times faster than real time (see "speed" on the
+    controller; it is rounded down to a divisor of the mains half-cycles
+    per tick, e.g. 8 runs at 6x on 60 Hz, and "get: speed" reports it).
+
+    Inputs are sent on each status line for the following tick, so they are
+    matched to controller ticks rather than host time; a capture row whose
+    sensed temperatures differ from the recorded ones means the input
+    arrived late (or a status line was dropped) and that tick isn't a fair
+    comparison."""
+
+    finished = QtCore.pyqtSignal()
+
+    TICK = 0.25     # seconds per control tick
+
+    def __init__(self,comm,filename,capture=None,speed=1,parent=None):
+        """Loads the recorded log; call start() to begin."""
+        super(OvenReplay,self).__init__(parent)
+
+        self.comm       = comm
+        self.speed      = speed
+        self.rows       = self.load(filename)
+        self.capture    = capture or 'replay_' + os.path.basename(filename)
+        self.f          = None
+        self.t0         = None
+        self.sent       = 0     # last row index whose inputs were sent
+        self.late       = 0
+        self.mismatch   = 0     # ticks where the state differs
+        self.max_err    = 0.0   # largest difference in the overall command
+
+    def load(self,filename):
+        """Reads a log into one row per control tick, holding the previous
+        row across any gaps (e.g. logs taken with telemetry deadbands)."""
+        rows = []
+        with open(filename) as f:
+            for r in csv.DictReader(f):
+                tick = int(round(float(r['time'])/self.TICK))
+                row = (r['state'],float(r['target']),float(r['sense_t']),float(r['sense_b']),
+                       float(r['cmd']),float(r['cmd_t']),float(r['cmd_b']))
+                while(rows and len(rows) < tick):
+                    rows.append(rows[-1])
+                if(len(rows) == tick or not rows):
+                    rows.append(row)
+        return rows
+
+    def start(self):
+        """Sets the controller up for the replay and starts feeding it."""
+        self.f = open(self.capture,'w')
+        print >> self.f, "tick,state,target,sense_t,sense_b,cmd,cmd_t,cmd_b,rec_state,rec_target,rec_cmd,rec_cmd_t,rec_cmd_b"
+
+        # the controller's clock runs fast during the replay
+        self.comm.ping_timer.stop()
+
+        self.comm.s.write("reset\nmanual: 0\nstream: 0\nfake_out: 1\nfake_in: 1\n")
+        self.comm.s.write("telemetry: fff, 1, 1\nspeed: %d\n" % (self.speed))
+        self.comm.newMessage.connect(self.message)
+
+    def send(self,i,prev):
+        """Sends the inputs for row i (prev is the row before, if any)."""
+        state,target,sense_t,sense_b = self.rows[i][:4]
+        cmds = ["temp: %d, %d" % (int(round(sense_t*4)),int(round(sense_b*4)))]
+        prev_state = prev[0] if prev else 'idle'
+        if(state == 'idle' and (not prev or prev[1] != target)):
+            cmds.append("target: %d" % (int(round(target*4))))
+        if(state != prev_state):
+            if(state == 'idle'):
+                cmds.append("reset")
+            elif(prev_state == 'idle'):
+                cmds.append("go")
+            elif(state == 'pause'):
+                cmds.append("pause")
+            elif(state == 'run' and prev_state == 'pause'):
+                cmds.append("resume")
+        self.comm.s.write("\n".join(cmds) + "\n")
+        self.sent = i
+
+    def message(self,msg):
+        """Callback for newMessage signals - captures the line for this
+        tick and sends the next tick's inputs."""
+        first = self.rows[0]
+        if(self.t0 is None):
+            # (re)send the first row until a tick has used it
+            if(msg.state != first[0] or msg.sense_t != first[2] or msg.sense_b != first[3]):
+                self.send(0,None)
+                return
+            self.t0 = msg.time
+
+        i = int(round((msg.time - self.t0)/self.TICK))
+        if(i >= len(self.rows)):
+            self.stop()
+            return
+
+        rec = self.rows[i]
+        if(msg.sense_t != rec[2] or msg.sense_b != rec[3]):
+            self.late += 1
+        elif(msg.state != rec[0]):
+            self.mismatch += 1
+        else:
+            self.max_err = max(self.max_err,abs(msg.cmd - rec[4]))
+
+        print >> self.f, "%d,%s,%f,%f,%f,%f,%f,%f,%s,%f,%f,%f,%f" % (i,
+            msg.state,msg.target,msg.sense_t,msg.sense_b,msg.cmd,msg.cmd_t,msg.cmd_b,
+            rec[0],rec[1],rec[4],rec[5],rec[6])
+
+        if(i+1 < len(self.rows)):
+            self.send(i+1,self.rows[self.sent])
+
+    def stop(self):
+        """Puts the controller back to normal and reports how the replay went."""
+        self.comm.newMessage.disconnect(self.message)
+        self.comm.s.write("speed: 1\nfake_in: 0\nfake_out: 0\nreset\n")
+        self.comm.ping_timer.start(5000)
+        if(self.f):
+            self.f.close()
+            self.f = None
+        print "replayed %d ticks to %s: %d late inputs, %d state differences, max command difference %.1f%%" % (
+            len(self.rows),self.capture,self.late,self.mismatch,self.max_err*100.0)
+        self.finished.emit()
 
 
 class OvenPlot(Qwt.QwtPlot):
@@ -564,12 +873,26 @@ class OvenCon(QtGui.QMainWindow):
         self.setCentralWidget(self.main)
 
 if __name__ == '__main__':
-    # start GUI application when invoked stand-alone
-    app = QtGui.QApplication(sys.argv)
     port = '/dev/cu.usbmodem73510';
     if(len(sys.argv)>1 and sys.argv[1]):
         # get serial port from command line
         port = sys.argv[1]
+
+    if(len(sys.argv)>2):
+        # ovencon.py <port> <log.csv> [speed] - replay a log without the GUI
+        app = QtCore.QCoreApplication(sys.argv)
+        try:
+            comm = OvenComm(port=port)
+        except serial.SerialException as se:
+            print "failed to open serial port - \"%s\"" % (se)
+            sys.exit(1)
+        replay = OvenReplay(comm,sys.argv[2],speed=int(sys.argv[3]) if len(sys.argv)>3 else 1)
+        replay.finished.connect(app.quit)
+        replay.start()
+        sys.exit(app.exec_())
+
+    # start GUI application when invoked stand-alone
+    app = QtGui.QApplication(sys.argv)
     try:
         qb = OvenCon(port)
     except serial.SerialException as se: